@@ -11,9 +11,13 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	Each name hashes to one of tableSize buckets, and the entries
+//	of a bucket are chained together through their "next" field, so
+//	FindIndex only compares the names that share a bucket.  Unused
+//	entries are chained the same way into a free list.  The bucket
+//	heads are part of the directory file, so FetchFrom has nothing
+//	to rebuild.  When the free list runs out, the directory file is
+//	extended and the table doubled and rehashed.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -21,8 +25,10 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "debug.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -36,14 +42,15 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
+    table = NULL;
+    buckets = NULL;
+    file = NULL;
+    Resize(size);
 
-    // MP4 mod tag
-    memset(table, 0, sizeof(DirectoryEntry) * size); // dummy operation to keep valgrind happy
-
-    tableSize = size;
+    freeList = 0;
     for (int i = 0; i < tableSize; i++){
         table[i].inUse = FALSE;
+        table[i].next = (i + 1 < tableSize) ? i + 1 : -1;
     }
 }
 
@@ -55,6 +62,45 @@ Directory::Directory(int size)
 Directory::~Directory()
 {
     delete[] table;
+    delete[] buckets;
+}
+
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Replace the in-core table and buckets by empty ones with room for
+//	"size" entries.
+//----------------------------------------------------------------------
+
+void Directory::Resize(int size)
+{
+    if (table != NULL){
+        delete[] table;
+        delete[] buckets;
+    }
+    table = new DirectoryEntry[size];
+    buckets = new int[size];
+
+    // MP4 mod tag
+    memset(table, 0, sizeof(DirectoryEntry) * size); // dummy operation to keep valgrind happy
+    memset(buckets, -1, sizeof(int) * size);
+
+    tableSize = size;
+}
+
+//----------------------------------------------------------------------
+// Directory::Hash
+// 	Return the bucket that "name" is chained into.  Only the first
+//	FileNameMaxLen characters count, as in the name comparisons.
+//----------------------------------------------------------------------
+
+int Directory::Hash(char *name)
+{
+    unsigned int hash = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++){
+        hash = hash * 31 + (unsigned char)name[i];
+    }
+    return hash % tableSize;
 }
 
 //----------------------------------------------------------------------
@@ -66,7 +112,23 @@ Directory::~Directory()
 
 void Directory::FetchFrom(OpenFile *file)
 {
-    (void)file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int length = file->Length();
+    char *buf = new char[length];
+    int size;
+
+    // the file holds exactly one directory, so read it in one go
+    (void)file->ReadAt(buf, length, 0);
+    memcpy(&size, buf, sizeof(int));
+    ASSERT(DirectorySize(size) <= length);
+    if (size != tableSize){
+        Resize(size);
+    }
+    memcpy(&freeList, buf + sizeof(int), sizeof(int));
+    memcpy(buckets, buf + 2 * sizeof(int), tableSize * sizeof(int));
+    memcpy(table, buf + 2 * sizeof(int) + tableSize * sizeof(int),
+           tableSize * sizeof(DirectoryEntry));
+    delete[] buf;
+    this->file = file;
 }
 
 //----------------------------------------------------------------------
@@ -78,7 +140,61 @@ void Directory::FetchFrom(OpenFile *file)
 
 void Directory::WriteBack(OpenFile *file)
 {
-    (void)file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = DirectorySize(tableSize);
+    char *buf = new char[size];
+
+    // assemble the whole file, so that every sector is written once
+    // and none has to be read first
+    ASSERT(file->Length() >= size);
+    memcpy(buf, &tableSize, sizeof(int));
+    memcpy(buf + sizeof(int), &freeList, sizeof(int));
+    memcpy(buf + 2 * sizeof(int), buckets, tableSize * sizeof(int));
+    memcpy(buf + 2 * sizeof(int) + tableSize * sizeof(int), table,
+           tableSize * sizeof(DirectoryEntry));
+    (void)file->WriteAt(buf, size, 0);
+    delete[] buf;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Double the size of a full directory: extend the file it was
+//	fetched from, then rehash every entry into the larger table.
+//	Return FALSE if the directory was not fetched from a file, or
+//	there is no room on disk to extend it.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool Directory::Grow(PersistentBitmap *freeMap)
+{
+    int oldSize = tableSize;
+    DirectoryEntry *oldTable = table;
+
+    ASSERT(freeList == -1);
+    if (file == NULL || !file->Extend(freeMap, DirectorySize(oldSize * 2))){
+        return FALSE;
+    }
+
+    table = NULL;
+    delete[] buckets;
+    buckets = NULL;
+    Resize(oldSize * 2);
+    for (int i = 0; i < oldSize; i++){
+        int bucket;
+
+        table[i] = oldTable[i];
+        bucket = Hash(table[i].name);
+        table[i].next = buckets[bucket];
+        buckets[bucket] = i;
+    }
+    delete[] oldTable;
+
+    freeList = oldSize;
+    for (int i = oldSize; i < tableSize; i++){
+        table[i].inUse = FALSE;
+        table[i].next = (i + 1 < tableSize) ? i + 1 : -1;
+    }
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -91,42 +207,48 @@ void Directory::WriteBack(OpenFile *file)
 
 int Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++){
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen)){
+    for (int i = buckets[Hash(name)]; i != -1; i = table[i].next){
+        if (!strncmp(table[i].name, name, FileNameMaxLen)){
             return i;
         }
     }
-        
+
     return -1; // name not in directory
 }
 
 // mp4
 // Find Recursive in the directory
+//	Walk "name" down from this directory, which must be the root.
+//	Each component is looked up in the dentry cache first; a
+//	directory is only consulted when one of its names misses, and
+//	comes from the file system's in-core copies.
 
 int Directory::FindRecursive(char *name){
     char head[FileNameMaxLen + 1];
-    int headSize;
-    headSize = PathHead(name, head); //head的長度
-
-    // check if head is in directory
-    int index = FindIndex(head);
-    // cout<<"find index: "<<index<<endl;
-    if(index == -1) return -1; // not in directory
+    int dirSector = RootDirectorySector;
+    int sector;
+
+    while(TRUE){
+        int headSize = PathHead(name, head); //head的長度
+
+        // check if head is in directory
+        sector = kernel->dentryCache->Lookup(dirSector, head);
+        if(sector == -1){
+            Directory *dir = kernel->fileSystem->FetchDirectory(dirSector);
+            int index = dir->FindIndex(head);
+            if(index != -1){
+                sector = dir->table[index].sector; //to file header sector
+                kernel->dentryCache->Insert(dirSector, head, sector);
+            }
+        }
 
-    // Last one in path
-    if(!strcmp(head, name+1)) return table[index].sector;
+        // not in directory, or last one in path
+        if(sector == -1 || !strcmp(head, name+1)) return sector;
 
-    // in directory
-    int sector = table[index].sector; //to file header sector 
-    
-    // There still exist directory in path
-    OpenFile *openFile = new OpenFile(sector); //to/t1/t2，open to file
-    Directory *dir = new Directory(NumDirEntries); 
-    dir->FetchFrom(openFile); //把openfile load進dir，以directory形式呈現
-    int rt = dir->FindRecursive(name+headSize+1);
-    delete openFile;
-    delete dir;
-    return rt;
+        // There still exist directory in path
+        name += headSize + 1;
+        dirSector = sector;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -151,7 +273,43 @@ int Directory::Find(char *name){
     // return sector;
     if(!strcmp(name, "/"))
         return RootDirectorySector;
-    return FindRecursive(name);
+
+    int sector = kernel->dentryCache->Lookup(-1, name);
+    if(sector == -1){
+        sector = FindRecursive(name);
+        if(sector != -1) kernel->dentryCache->Insert(-1, name, sector);
+    }
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return TRUE if "name", a path looked up from this, the root
+//	directory, names a directory; FALSE if it names a regular file,
+//	or nothing.  The type is kept in the entry in its parent.
+//
+//	"name" -- the path to look up
+//----------------------------------------------------------------------
+
+bool Directory::IsDirectory(char *name)
+{
+    if (!strcmp(name, "/"))
+        return TRUE;
+    if (Find(name) == -1)
+        return FALSE;
+
+    char *last = strrchr(name, '/');
+    char *parent = new char[last - name + 2];
+    if (last == name)
+        strcpy(parent, "/");
+    else{
+        strncpy(parent, name, last - name);
+        parent[last - name] = '\0';
+    }
+    Directory *dir = kernel->fileSystem->FetchDirectory(Find(parent));
+    int index = dir->FindIndex(last + 1);
+    delete[] parent;
+    return index != -1 && dir->table[index].type == 1;
 }
 
 //----------------------------------------------------------------------
@@ -163,9 +321,11 @@ int Directory::Find(char *name){
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"freeMap" -- the bit map of free disk sectors, used if the
+//		directory has to grow
 //----------------------------------------------------------------------
 
-bool Directory::Add(char *name, int newSector, int type)
+bool Directory::Add(char *name, int newSector, int type, PersistentBitmap *freeMap)
 {
     // name = name + 1; // ignore the first slash
     // if (FindIndex(name) != -1)
@@ -181,45 +341,47 @@ bool Directory::Add(char *name, int newSector, int type)
     //     }
     // return FALSE; // no space.  Fix when we have extensible files.
     // cout<<"---AddRecursive---\n";
-    bool pass =  AddRecursive(name, newSector, type); //newsector 是fileheader的sector
+    bool pass =  AddRecursive(name, newSector, type, freeMap, RootDirectorySector); //newsector 是fileheader的sector
     // cout<<"---End AddRecursive---\n";
     return pass;
 }
 
-bool Directory::AddRecursive(char *name, int newSector, int type){
+bool Directory::AddRecursive(char *name, int newSector, int type, PersistentBitmap *freeMap,
+                             int dirSector){
     char head[FileNameMaxLen + 1];
     int headSize = PathHead(name, head);
 
     if(!strcmp(name + 1, head)){//head is the last one in path
-        for(int i=0;i<tableSize;i++){
-            if (!table[i].inUse){
-                table[i].inUse = TRUE;
-                table[i].type = type;
-                table[i].sector = newSector; //to file headersector
-                strncpy(table[i].name, head, FileNameMaxLen);
-                // cout<<"----------\n";
-                // cout<<"Add File:"<<name<<"\n";
-                // cout<<"Sector: "<<newSector<<endl;
-                // cout<<"Type: "<<(type==1?"[D]":"[F]")<<endl;
-                // cout<<"----------\n";
-                return true;
-            }
-        }
-        return false;
+        if(FindIndex(head) != -1) return false; // already in directory
+        if(freeList == -1 && !Grow(freeMap)) return false; // no space
+
+        int i = freeList;
+        int bucket = Hash(head);
+        freeList = table[i].next;
+        table[i].inUse = TRUE;
+        table[i].type = type;
+        table[i].sector = newSector; //to file headersector
+        strncpy(table[i].name, head, FileNameMaxLen);
+        table[i].name[FileNameMaxLen] = '\0';
+        table[i].next = buckets[bucket];
+        buckets[bucket] = i;
+        kernel->dentryCache->Insert(dirSector, head, newSector);
+        return true;
     }else{
-        for(int i=0;i<tableSize;i++){
-            if (!strcmp(head, table[i].name) && table[i].inUse){
-                OpenFile *openFile = new OpenFile(table[i].sector);
-                Directory *dir = new Directory(NumDirEntries);
-                dir->FetchFrom(openFile);
-                bool pass = dir->AddRecursive(name+headSize+1, newSector, type);//mp4why
-                dir->WriteBack(openFile);
-                delete dir;
-                delete openFile;
-                return pass;
-            }
+        int index = FindIndex(head);
+        if(index == -1) return false; // not in directory
+
+        int sector = table[index].sector;
+        Directory *dir = kernel->fileSystem->FetchDirectory(sector);
+        bool pass = dir->AddRecursive(name+headSize+1, newSector, type, freeMap,
+                                      sector);//mp4why
+        // a deep path may have pushed dir out of the file system's
+        // cache; fetch it again (it was not changed if it was)
+        if(pass){
+            dir = kernel->fileSystem->FetchDirectory(sector);
+            dir->WriteBack(dir->file);
         }
-        return false;
+        return pass;
     }
     return false;
 }
@@ -241,10 +403,10 @@ bool Directory::Remove(char *name)
     // table[i]. = FALSE;
     // return TRUE;
 
-    return RemoveRecursive(name);
+    return RemoveRecursive(name, RootDirectorySector);
 }
 
-bool Directory::RemoveRecursive(char *name){
+bool Directory::RemoveRecursive(char *name, int dirSector){
     char head[FileNameMaxLen + 1];
     int headSize;
     headSize = PathHead(name, head);
@@ -256,20 +418,27 @@ bool Directory::RemoveRecursive(char *name){
 
     // Last in path
     if(!strcmp(head, name+1)){
+        int *link = &buckets[Hash(head)];
+        while(*link != index) link = &table[*link].next;
+        *link = table[index].next; // unchain from its bucket
+
         table[index].inUse = false;
+        table[index].next = freeList;
+        freeList = index;
+        kernel->dentryCache->Remove(dirSector, head, table[index].sector);
         return true;
     }
     
     // in directory
     int sector = table[index].sector;
     // There still exist directory in path
-    OpenFile *openFile = new OpenFile(sector);
-    Directory *dir = new Directory(NumDirEntries);
-    dir->FetchFrom(openFile);
-    bool pass = dir->RemoveRecursive(name+headSize+1);
-    dir->WriteBack(openFile);
-    delete dir;
-    delete openFile;
+    Directory *dir = kernel->fileSystem->FetchDirectory(sector);
+    bool pass = dir->RemoveRecursive(name+headSize+1, sector);
+    // fetched again, as in AddRecursive
+    if(pass){
+        dir = kernel->fileSystem->FetchDirectory(sector);
+        dir->WriteBack(dir->file);
+    }
     return pass;
 }
 
@@ -308,12 +477,14 @@ void Directory::ListRecursive(int level){
                 cout<<"[D] ";
                 printf("%s\n", table[i].name);
 
-                OpenFile *openFile = new OpenFile(table[i].sector);
-                Directory *dir = new Directory(NumDirEntries);
-                dir->FetchFrom(openFile);
-                dir->ListRecursive(level+1);
-                delete dir;
-                delete openFile;
+                // a private copy: listing it must not push this one
+                // out of the file system's cache
+                OpenFile *subFile = new OpenFile(table[i].sector);
+                Directory *sub = new Directory(NumDirEntries);
+                sub->FetchFrom(subFile);
+                sub->ListRecursive(level+1);
+                delete sub;
+                delete subFile;
             }
         }
     }
@@ -359,4 +530,139 @@ int Directory::PathHead(char *name, char*head){
     // cout<<"name: "<<name<<endl;
 
     return headSize;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache of name lookups.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    for (int i = 0; i < DentryCacheBuckets; i++){
+        buckets[i] = NULL;
+    }
+    numEntries = 0;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache and all of its entries.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    Clear();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Hash
+// 	Return the hash chain that holds <parent, name>.
+//----------------------------------------------------------------------
+
+int DentryCache::Hash(int parent, char *name)
+{
+    unsigned int hash = parent;
+
+    for (char *c = name; *c != '\0'; c++){
+        hash = hash * 31 + (unsigned char)*c;
+    }
+    return hash % DentryCacheBuckets;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return the header sector cached for "name" in the directory whose
+//	header is at "parent" (or for the whole path "name", if "parent"
+//	is -1).  Return -1 if it is not cached.
+//----------------------------------------------------------------------
+
+int DentryCache::Lookup(int parent, char *name)
+{
+    for (DentryCacheEntry *e = buckets[Hash(parent, name)]; e != NULL; e = e->next){
+        if (e->parent == parent && !strcmp(e->name, name)){
+            return e->sector;
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Insert
+// 	Remember that "name" in directory "parent" has its header at
+//	"sector".  Empty the cache first if it is full.
+//----------------------------------------------------------------------
+
+void DentryCache::Insert(int parent, char *name, int sector)
+{
+    int bucket = Hash(parent, name);
+    DentryCacheEntry *e;
+
+    for (e = buckets[bucket]; e != NULL; e = e->next){
+        if (e->parent == parent && !strcmp(e->name, name)){
+            e->sector = sector;
+            return;
+        }
+    }
+
+    if (numEntries >= DentryCacheSize){
+        Clear();
+    }
+    e = new DentryCacheEntry;
+    e->parent = parent;
+    e->name = new char[strlen(name) + 1];
+    strcpy(e->name, name);
+    e->sector = sector;
+    e->next = buckets[bucket];
+    buckets[bucket] = e;
+    numEntries++;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Remove
+// 	Forget "name" in directory "parent", whose header was at "sector".
+//	Names cached inside it go too, since its header sector may now be
+//	reused, and so do all whole paths, since any of them may have run
+//	through it.  The remaining component entries are still valid, so
+//	paths are resolved again without directory I/O.
+//----------------------------------------------------------------------
+
+void DentryCache::Remove(int parent, char *name, int sector)
+{
+    for (int i = 0; i < DentryCacheBuckets; i++){
+        DentryCacheEntry **link = &buckets[i];
+
+        while (*link != NULL){
+            DentryCacheEntry *e = *link;
+
+            if (e->parent == -1 || e->parent == sector ||
+                (e->parent == parent && !strcmp(e->name, name))){
+                *link = e->next;
+                delete[] e->name;
+                delete e;
+                numEntries--;
+            }else{
+                link = &e->next;
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Clear
+// 	Forget every cached lookup.
+//----------------------------------------------------------------------
+
+void DentryCache::Clear()
+{
+    for (int i = 0; i < DentryCacheBuckets; i++){
+        while (buckets[i] != NULL){
+            DentryCacheEntry *e = buckets[i];
+
+            buckets[i] = e->next;
+            delete[] e->name;
+            delete e;
+        }
+    }
+    numEntries = 0;
+}
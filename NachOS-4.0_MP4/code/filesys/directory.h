@@ -6,6 +6,11 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	The entries are chained into hash buckets by name, and the
+//	buckets are stored on disk along with the table, so looking a
+//	name up does not scan the directory.  A full directory doubles
+//	in size.
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -18,13 +23,19 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "pbitmap.h"
 
 #define FileNameMaxLen 9 // for simplicity, we assume \
                          // file names are <= 9 characters long
-#define NumDirEntries 64
+#define NumDirEntries 64 // initial number of entries in a directory
 
 #define RootDirectorySector 1
-#define DirectoryFileSize (sizeof(DirectoryEntry) * NumDirEntries)
+
+// mp4
+// On disk, a directory with "n" entries is laid out as
+//	tableSize, freeList, buckets[n], table[n]
+#define DirectorySize(n) ((int)(2 * sizeof(int) + (n) * (sizeof(int) + sizeof(DirectoryEntry))))
+#define DirectoryFileSize DirectorySize(NumDirEntries)
 
 
 // The following class defines a "directory entry", representing a file
@@ -43,6 +54,9 @@ public:
                                    //   FileHeader for this file
     char name[FileNameMaxLen + 1]; // Text name for file, with +1 for
                                    // the trailing '\0'
+    int next;                      // mp4: next entry in the same hash
+                                   //   bucket, or in the free list; -1
+                                   //   at the end of the chain
 };
 
 // The following class defines a UNIX-like "directory".  Each entry in
@@ -69,7 +83,11 @@ public:
     int Find(char *name); // Find the sector number of the
                           // FileHeader for file: "name"
 
-    bool Add(char *name, int newSector, int type); // Add a file name into the directory
+    bool IsDirectory(char *name); // mp4: whether "name" is a directory
+
+    bool Add(char *name, int newSector, int type,
+             PersistentBitmap *freeMap); // Add a file name into the directory,
+                                         //  growing it out of "freeMap" if full
 
     bool Remove(char *name); // Remove a file from the directory
 
@@ -86,22 +104,81 @@ private:
     /*
 		MP4 Hint:
 		Directory is actually a "file", be careful of how it works with OpenFile and FileHdr.
-		Disk part: table
-		In-core part: tableSize
+		Disk part: tableSize, freeList, buckets, table
+		In-core part: file
 	*/
-    int tableSize;         // Number of directory entries
+    int tableSize;         // Number of directory entries, and of
+                           // hash buckets
+    int freeList;          // First unused entry, or -1 if full
+    int *buckets;          // First entry of each hash chain, or -1
     DirectoryEntry *table; // Table of pairs:
                            // <file name, file header location>
 
+    OpenFile *file;        // File the directory was fetched from,
+                           // extended when the table grows
+
     int FindIndex(char *name); // Find the index into the directory
                                //  table corresponding to "name"
-    int FindRecursive(char *name);
+    int FindRecursive(char *name); // Walk "name" down from this, the
+                                   //  root directory
+
+    int Hash(char *name);  // Bucket holding "name"
+    void Resize(int size); // Reallocate the in-core table
+    bool Grow(PersistentBitmap *freeMap); // Double the table
 
-    bool AddRecursive(char *name, int sector, int type);
+    bool AddRecursive(char *name, int sector, int type, PersistentBitmap *freeMap,
+                      int dirSector); // "dirSector" holds this directory's header
 
-    bool RemoveRecursive(char *name);
+    bool RemoveRecursive(char *name, int dirSector);
 
     void ListRecursive(int level);
 };
 
+// mp4
+// The following class defines a kernel-wide cache of name lookups, so
+// that resolving a path again does no directory I/O.  An entry maps
+// <parent, name> to the sector holding the header of file "name",
+// where "parent" is the header sector of the directory containing it.
+// Whole paths are cached too, with a parent of -1, so repeating a
+// lookup costs a single probe.
+//
+// Only names that exist are cached: Add enters the new name, and
+// Remove drops the entries it makes stale.  When the cache fills up,
+// it is simply emptied.
+
+#define DentryCacheSize 1024   // entries kept before emptying the cache
+#define DentryCacheBuckets 256 // hash chains
+
+class DentryCacheEntry
+{
+public:
+    int parent;              // directory header sector, or -1
+    char *name;              // component name, or whole path
+    int sector;              // header sector of the named file
+    DentryCacheEntry *next;  // next entry in the same hash chain
+};
+
+class DentryCache
+{
+public:
+    DentryCache();  // Initialize an empty cache
+    ~DentryCache(); // De-allocate the cache
+
+    int Lookup(int parent, char *name); // Return the header sector of
+                                        //  "name", or -1 if not cached
+    void Insert(int parent, char *name, int sector); // Remember a lookup
+
+    void Remove(int parent, char *name, int sector); // Forget a removed
+                                        //  file, anything cached under
+                                        //  it, and all whole paths
+
+    void Clear(); // Forget everything
+
+private:
+    DentryCacheEntry *buckets[DentryCacheBuckets];
+    int numEntries; // Number of entries in the chains
+
+    int Hash(int parent, char *name); // Chain holding <parent, name>
+};
+
 #endif // DIRECTORY_H
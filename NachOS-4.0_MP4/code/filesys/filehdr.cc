@@ -5,10 +5,13 @@
 //	The file header is used to locate where on disk the
 //	file's data is stored.  We implement this as a fixed size
 //	table of pointers -- each entry in the table points to the
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector,
+//	disk sector containing that portion of the file data --
+//	followed by one singly indirect and one doubly indirect
+//	index sector for the rest of the file.  The table size is
+//	chosen so that the file header will be just big enough to fit
+//	in one disk sector, and data sectors hold nothing but file data.
+//	A file small enough to fit in place of the table is kept in the
+//	header sector itself.
 //
 //      Unlike in a real system, we do not keep track of file permissions,
 //	ownership, last modification date, etc., in the file header.
@@ -20,7 +23,7 @@
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
-// of liability and nextBlockSectordisclaimer of warranty provisions.
+// of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 
@@ -29,48 +32,49 @@
 #include "synchdisk.h"
 #include "main.h"
 
-Block::Block(){};
-Block::Block(int nowSector, int newSector){
-	this->blockSector = nowSector;
-	this->nextBlockSector = newSector;
-}
-Block::~Block(){};
-
-void Block::FetchFrom(int sectorNumber){
-	kernel->synchDisk->ReadSector(sectorNumber, (char *)this);
-	//Read the contents of a disk sector into a buffer.  Return only after the data has been read.
-	//("sectorNumber" -- the disk sector to read,"data" -- the buffer to hold the contents of the disk sector)
-}
+//----------------------------------------------------------------------
+// mp4
+// IndirectBlock::IndirectBlock
+//	Initialize an empty index sector; every entry is unused.
+//----------------------------------------------------------------------
 
-void Block::WriteBack(){
-	kernel->synchDisk->WriteSector(blockSector, (char *)this);
-	//Write the contents of a buffer into a disk sector.  Return only after the data has been written.
-        //("sectorNumber" -- the disk sector to be written,"data" -- the new contents of the disk sector)
+IndirectBlock::IndirectBlock()
+{
+	for (int i = 0; i < NumIndirect; i++)
+		dataSectors[i] = -1;
 }
 
-int Block::GetBlockSector(){
-	return blockSector;
+IndirectBlock::~IndirectBlock()
+{
 }
 
-void Block::SetBlockSector(int nowSector){
-	blockSector = nowSector;
-}
+//----------------------------------------------------------------------
+// IndirectBlock::FetchFrom/WriteBack
+//	Read/write the index sector from/to the disk.
+//
+//	"sectorNumber" is the disk sector containing the index
+//----------------------------------------------------------------------
 
-int Block::GetNextSector(){
-	return nextBlockSector;
+void IndirectBlock::FetchFrom(int sectorNumber)
+{
+	kernel->synchDisk->ReadSector(sectorNumber, (char *)dataSectors);
 }
 
-void Block::SetNextSector(int newSector){
-	nextBlockSector = newSector;
+void IndirectBlock::WriteBack(int sectorNumber)
+{
+	kernel->synchDisk->WriteSector(sectorNumber, (char *)dataSectors);
 }
 
-char* Block::GetData(){
-	return (char*)data;
+int IndirectBlock::GetSector(int index)
+{
+	ASSERT(index >= 0 && index < NumIndirect);
+	return dataSectors[index];
 }
 
-bool Block::SetNext(int newSector){
-	nextBlockSector = newSector;
-	return true;
+void IndirectBlock::SetSector(int index, int sector)
+{
+	ASSERT(index >= 0 && index < NumIndirect);
+	dataSectors[index] = sector;
 }
 
 //----------------------------------------------------------------------
@@ -84,9 +88,11 @@ FileHeader::FileHeader()
 {
 	numBytes = -1;
 	numSectors = -1;
-	firstBlockSector = -1;
-
-	// memset(dataSectors, -1, sizeof(dataSectors));
+	singleIndirectSector = -1;
+	doubleIndirectSector = -1;
+	memset(dataSectors, -1, sizeof(dataSectors));
+	memset(inlineData, 0, sizeof(inlineData));
+	sectorMap = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -98,7 +104,8 @@ FileHeader::FileHeader()
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	// nothing to do now
+	if (sectorMap != NULL)
+		delete[] sectorMap;
 }
 
 //----------------------------------------------------------------------
@@ -106,75 +113,255 @@ FileHeader::~FileHeader()
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the new file.  A file of at most MaxInlineSize bytes needs none.
 //
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the size of the new file in bytes
 //----------------------------------------------------------------------
 
 // mp4
 bool FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 {
-	// cout<<"Allocate "<<fileSize<<endl;
-	numBytes = fileSize;
-	numSectors = divRoundUp(fileSize, BlockDataSize);
-	// cout<<"numSector: "<<numSectors<<endl;
-	if (freeMap->NumClear() < numSectors)
+	numBytes = 0;
+	numSectors = 0;
+	singleIndirectSector = -1;
+	doubleIndirectSector = -1;
+	memset(dataSectors, -1, sizeof(dataSectors));
+	memset(inlineData, 0, sizeof(inlineData));
+	if (sectorMap != NULL)
+		delete[] sectorMap;
+	sectorMap = NULL;
+
+	return Extend(freeMap, fileSize);
+}
+
+//----------------------------------------------------------------------
+// IndexSectors
+// 	Return the number of index sectors a file of "numSectors" data
+//	blocks needs on top of its data blocks.
+//----------------------------------------------------------------------
+
+static int IndexSectors(int numSectors)
+{
+	int numIndexSectors = 0;
+	int numDouble = numSectors - NumDirect - NumIndirect;
+
+	if (numSectors > NumDirect)
+		numIndexSectors++;
+	if (numDouble > 0)
+		numIndexSectors += 1 + divRoundUp(numDouble, NumIndirect);
+	return numIndexSectors;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorsToGrow
+// 	Return how many free sectors, data blocks and index sectors both,
+//	Extend would take to grow the file to "newSize" bytes.
+//----------------------------------------------------------------------
+
+int FileHeader::SectorsToGrow(int newSize)
+{
+	int newNumSectors = divRoundUp(newSize, SectorSize);
+
+	if (newSize <= numBytes || (IsInline() && newSize <= MaxInlineSize))
+		return 0;
+	return newNumSectors - numSectors +
+		   IndexSectors(newNumSectors) - IndexSectors(numSectors);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file to "newSize" bytes, allocating the data blocks and
+//	index sectors it now needs out of the map of free disk blocks.
+//	Return FALSE, leaving the file unchanged, if the file would be
+//	too big or there are not enough free blocks.
+//
+//	The data blocks are taken from the free map in runs of consecutive
+//	sectors, as long as it can supply them, so a new file is laid out
+//	contiguously.  The index sectors are filled in memory and each
+//	one that changes is written to disk exactly once, all together
+//	after the data blocks have been found.  The header itself is not
+//	written back; that is up to the caller.
+//
+//	An inline file stays inline while it fits.  Once it does not, it
+//	gets data blocks like any other file, and its bytes are moved to
+//	the first of them.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newSize" is the new size of the file in bytes
+//----------------------------------------------------------------------
+
+bool FileHeader::Extend(PersistentBitmap *freeMap, int newSize)
+{
+	int newNumSectors = divRoundUp(newSize, SectorSize);
+	bool wasInline = IsInline();
+
+	if (newSize <= numBytes)
+		return TRUE; // files never shrink
+	if (wasInline && newSize <= MaxInlineSize)
+	{
+		numBytes = newSize;
+		return TRUE;
+	}
+	if (newNumSectors > MaxFileSectors)
+		return FALSE; // file too big for the index
+	if (freeMap->NumClear() < SectorsToGrow(newSize))
 		return FALSE; // not enough space
 
-	int nowSector=-1, newSector = -1;
-	for (int i = 0; i < numSectors; i++){
-		newSector = freeMap->FindAndSet(); // find a free sector //
-
-		// cout<<"Index: "<<i<<endl;
-		if(nowSector == -1){ // header
-			firstBlockSector = newSector;
-		}else{ // blocks
-			Block *nowBlock = new Block();
-			nowBlock->FetchFrom(nowSector);
-			nowBlock->SetNext(newSector);
-			nowBlock->WriteBack();
-			delete nowBlock;
+	if (newNumSectors > numSectors || sectorMap == NULL)
+	{
+		int *newMap = new int[newNumSectors > 0 ? newNumSectors : 1];
+		for (int i = 0; i < numSectors; i++)
+			newMap[i] = sectorMap[i];
+		if (sectorMap != NULL)
+			delete[] sectorMap;
+		sectorMap = newMap;
+	}
+
+	IndirectBlock *single = NULL;
+	IndirectBlock *outer = NULL;
+	IndirectBlock *inner[NumIndirect]; // second-level index sectors touched
+	int runStart = -1;
+	int runLength = 0;
+
+	for (int i = 0; i < NumIndirect; i++)
+		inner[i] = NULL;
+
+	for (int i = numSectors; i < newNumSectors; i++)
+	{
+		if (runLength == 0)
+		{ // since we checked that there was enough free space,
+		  // we expect this to succeed
+			runLength = freeMap->FindAndSetRun(newNumSectors - i, &runStart);
+			ASSERT(runLength > 0);
+		}
+		int sector = runStart++;
+		runLength--;
+		sectorMap[i] = sector;
+
+		if (i < NumDirect)
+		{
+			dataSectors[i] = sector;
+			continue;
+		}
+
+		int index = i - NumDirect;
+		if (index < NumIndirect)
+		{
+			if (single == NULL)
+			{
+				single = new IndirectBlock;
+				if (singleIndirectSector == -1)
+				{
+					singleIndirectSector = freeMap->FindAndSet();
+					ASSERT(singleIndirectSector >= 0);
+				}
+				else
+					single->FetchFrom(singleIndirectSector);
+			}
+			single->SetSector(index, sector);
+			continue;
+		}
+
+		index -= NumIndirect;
+		if (outer == NULL)
+		{
+			outer = new IndirectBlock;
+			if (doubleIndirectSector == -1)
+			{
+				doubleIndirectSector = freeMap->FindAndSet();
+				ASSERT(doubleIndirectSector >= 0);
+			}
+			else
+				outer->FetchFrom(doubleIndirectSector);
+		}
+		IndirectBlock *block = inner[index / NumIndirect];
+		if (block == NULL)
+		{ // first block in this second-level index sector
+			block = inner[index / NumIndirect] = new IndirectBlock;
+			int innerSector = outer->GetSector(index / NumIndirect);
+			if (innerSector == -1)
+			{
+				innerSector = freeMap->FindAndSet();
+				ASSERT(innerSector >= 0);
+				outer->SetSector(index / NumIndirect, innerSector);
+			}
+			else
+				block->FetchFrom(innerSector);
 		}
-		Block *newBlock = new Block(newSector, -1);
-		newBlock->WriteBack();
-		delete newBlock;
-
-		ASSERT(newSector >= 0);
-		nowSector = newSector;
-		// ASSERT(newSector >= 0);
-		// dataSectors[i] = freeMap->FindAndSet();
-		// since we checked that there was enough free space,
-		// we expect this to succeed
-		// ASSERT(dataSectors[i] >= 0);
+		block->SetSector(index % NumIndirect, sector);
 	}
+
+	// write the changed index sectors in one batch, in the order they
+	// were allocated
+	if (single != NULL)
+	{
+		single->WriteBack(singleIndirectSector);
+		delete single;
+	}
+	if (outer != NULL)
+	{
+		outer->WriteBack(doubleIndirectSector);
+		for (int i = 0; i < NumIndirect; i++)
+			if (inner[i] != NULL)
+			{
+				inner[i]->WriteBack(outer->GetSector(i));
+				delete inner[i];
+			}
+		delete outer;
+	}
+
+	if (wasInline && numBytes > 0)
+	{ // move the data out of the header
+		char buf[SectorSize];
+
+		memset(buf, 0, sizeof(buf));
+		memcpy(buf, inlineData, numBytes);
+		kernel->synchDisk->WriteSector(sectorMap[0], buf);
+	}
+
+	numBytes = newSize;
+	numSectors = newNumSectors;
 	return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	including the index sectors.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
 
 void FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
-	int nowSector = firstBlockSector;
-	while(nowSector != -1){
-		Block *block = new Block;
-		block->FetchFrom(nowSector);
-
-		ASSERT(freeMap->Test(nowSector)); // ought to be marked!
-		freeMap->Clear(nowSector);
+	for (int i = 0; i < numSectors; i++)
+	{
+		ASSERT(freeMap->Test(sectorMap[i])); // ought to be marked!
+		freeMap->Clear(sectorMap[i]);
+	}
 
-		nowSector = block->GetNextSector();
+	if (singleIndirectSector != -1)
+	{
+		ASSERT(freeMap->Test(singleIndirectSector));
+		freeMap->Clear(singleIndirectSector);
+	}
+	if (doubleIndirectSector != -1)
+	{
+		IndirectBlock *outer = new IndirectBlock;
+		outer->FetchFrom(doubleIndirectSector);
+		for (int i = 0; i < NumIndirect; i++)
+		{
+			int innerSector = outer->GetSector(i);
+			if (innerSector == -1)
+				break;
+			ASSERT(freeMap->Test(innerSector));
+			freeMap->Clear(innerSector);
+		}
+		delete outer;
+		ASSERT(freeMap->Test(doubleIndirectSector));
+		freeMap->Clear(doubleIndirectSector);
 	}
-	// for (int i = 0; i < numSectors; i++)
-	// {
-	// 	ASSERT(freeMap->Test((int)dataSectors[i])); // ought to be marked!
-	// 	freeMap->Clear((int)dataSectors[i]);
-	// }
 }
 
 //----------------------------------------------------------------------
@@ -186,29 +373,38 @@ void FileHeader::Deallocate(PersistentBitmap *freeMap)
 
 // mp4
 void FileHeader::FetchFrom(int sector)
-{	
-	// cout<<"Fetch from sector\n";
-	char *buf = new char[SectorSize];
+{
+	char buf[SectorSize];
+	int offset = 0;
 
 	kernel->synchDisk->ReadSector(sector, buf);
-	bcopy(buf, (char*)this, sizeof(FileHeader));
 
-	//Reminder: filehdr FrtchFrom and WirteBack work correctly...
-	// cout<<"-------\n";
-	// cout<<"firstBlockSector: "<<firstBlockSector<<endl;
-	// cout<<"numBytes: "<<numBytes<<endl;
-	// cout<<"numSectors: "<<numSectors<<endl;
-	// cout<<"-------\n";
-
-	// Print();
-
-	delete []buf;
+	memcpy(&numBytes, buf + offset, sizeof(numBytes));
+	offset += sizeof(numBytes);
+	memcpy(&numSectors, buf + offset, sizeof(numSectors));
+	offset += sizeof(numSectors);
+	if (IsInline())
+	{ // the rest of the sector is file data
+		memcpy(inlineData, buf + offset, sizeof(inlineData));
+		memset(dataSectors, -1, sizeof(dataSectors));
+		singleIndirectSector = -1;
+		doubleIndirectSector = -1;
+		BuildSectorMap();
+		return;
+	}
+	memcpy(dataSectors, buf + offset, sizeof(dataSectors));
+	offset += sizeof(dataSectors);
+	memcpy(&singleIndirectSector, buf + offset, sizeof(singleIndirectSector));
+	offset += sizeof(singleIndirectSector);
+	memcpy(&doubleIndirectSector, buf + offset, sizeof(doubleIndirectSector));
+	offset += sizeof(doubleIndirectSector);
+	ASSERT(offset <= SectorSize);
 
-	// kernel->synchDisk->ReadSector(sector, (char *)this);
 	/*
 		MP4 Hint:
 		After you add some in-core informations, you will need to rebuild the header's structure
 	*/
+	BuildSectorMap();
 }
 
 //----------------------------------------------------------------------
@@ -220,24 +416,70 @@ void FileHeader::FetchFrom(int sector)
 // mp4
 void FileHeader::WriteBack(int sector)
 {
-	char *buf = new char[SectorSize];
-
-	kernel->synchDisk->ReadSector(sector, buf);
-
-	bcopy((char *)this, buf, sizeof(FileHeader));
+	char buf[SectorSize];
+	int offset = 0;
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf + offset, &numBytes, sizeof(numBytes));
+	offset += sizeof(numBytes);
+	memcpy(buf + offset, &numSectors, sizeof(numSectors));
+	offset += sizeof(numSectors);
+	if (IsInline())
+	{
+		memcpy(buf + offset, inlineData, sizeof(inlineData));
+		kernel->synchDisk->WriteSector(sector, buf);
+		return;
+	}
+	memcpy(buf + offset, dataSectors, sizeof(dataSectors));
+	offset += sizeof(dataSectors);
+	memcpy(buf + offset, &singleIndirectSector, sizeof(singleIndirectSector));
+	offset += sizeof(singleIndirectSector);
+	memcpy(buf + offset, &doubleIndirectSector, sizeof(doubleIndirectSector));
+	offset += sizeof(doubleIndirectSector);
+	ASSERT(offset <= SectorSize);
 
 	kernel->synchDisk->WriteSector(sector, buf);
-	delete []buf;
+}
 
-	// kernel->synchDisk->WriteSector(sector, (char *)this);
-	/*
-		MP4 Hint:
-		After you add some in-core informations, you may not want to write all fields into disk.
-		Use this instead:
-		char buf[SectorSize];
-		memcpy(buf + offset, &dataToBeWritten, sizeof(dataToBeWritten));
-		...
-	*/
+//----------------------------------------------------------------------
+// FileHeader::BuildSectorMap
+// 	Rebuild the in-core table mapping each data block of the file to
+//	its disk sector.  The singly indirect sector, the doubly indirect
+//	sector and each of its second-level index sectors are read exactly
+//	once, so opening a file costs a handful of sector reads and every
+//	later offset lookup is free.
+//----------------------------------------------------------------------
+
+void FileHeader::BuildSectorMap()
+{
+	if (sectorMap != NULL)
+		delete[] sectorMap;
+	sectorMap = new int[numSectors > 0 ? numSectors : 1];
+
+	int i;
+	for (i = 0; i < numSectors && i < NumDirect; i++)
+		sectorMap[i] = dataSectors[i];
+	if (i == numSectors)
+		return;
+
+	IndirectBlock *block = new IndirectBlock;
+	block->FetchFrom(singleIndirectSector);
+	for (int j = 0; i < numSectors && j < NumIndirect; i++, j++)
+		sectorMap[i] = block->GetSector(j);
+
+	if (i < numSectors)
+	{
+		IndirectBlock *outer = new IndirectBlock;
+		outer->FetchFrom(doubleIndirectSector);
+		for (int k = 0; i < numSectors; k++)
+		{
+			block->FetchFrom(outer->GetSector(k));
+			for (int j = 0; i < numSectors && j < NumIndirect; i++, j++)
+				sectorMap[i] = block->GetSector(j);
+		}
+		delete outer;
+	}
+	delete block;
 }
 
 //----------------------------------------------------------------------
@@ -250,28 +492,12 @@ void FileHeader::WriteBack(int sector)
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
-void FileHeader::ByteToSectorAndNextSector(int offset, int *a, int *b)
+int FileHeader::ByteToSector(int offset)
 {
-	int remainingBytes = offset;
-	int nowSector = -1;
-	int newSector = firstBlockSector;
-	while(remainingBytes >= 0){
-		Block *block = new Block;
-		nowSector = newSector;
-		block->FetchFrom(nowSector);
-		//Read the contents of a disk sector into a buffer.  Return only after the data has been read.
-		newSector = block->GetNextSector();//return nextblock
-		delete block;
-		remainingBytes -= BlockDataSize;
-		// cout<<"----------------\n";
-		// cout<<"Now Sector: "<<nowSector<<endl;
-		// cout<<"New Sector: "<<newSector<<endl;
-		// cout<<"----------------\n";
-	}
-	ASSERT(nowSector != -1);
-	(*a) = nowSector;
-	(*b) = newSector;
-	// return (dataSectors[offset / SectorSize]);
+	int index = offset / SectorSize;
+
+	ASSERT(index >= 0 && index < numSectors);
+	return sectorMap[index];
 }
 
 //----------------------------------------------------------------------
@@ -284,6 +510,30 @@ int FileHeader::FileLength()
 	return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::ReadInline/WriteInline
+// 	Copy part of an inline file's data out of/into the header.  The
+//	range must lie within the file.  A write reaches the disk when
+//	the header is written back.
+//
+//	"into" -- the buffer to hold the data
+//	"from" -- the buffer holding the new data
+//	"numBytes" -- the number of bytes to copy
+//	"position" -- the offset within the file of the first byte
+//----------------------------------------------------------------------
+
+void FileHeader::ReadInline(char *into, int numBytes, int position)
+{
+	ASSERT(IsInline() && position >= 0 && position + numBytes <= this->numBytes);
+	bcopy(inlineData + position, into, numBytes);
+}
+
+void FileHeader::WriteInline(char *from, int numBytes, int position)
+{
+	ASSERT(IsInline() && position >= 0 && position + numBytes <= this->numBytes);
+	bcopy(from, inlineData + position, numBytes);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -292,58 +542,28 @@ int FileHeader::FileLength()
 
 void FileHeader::Print()
 {
+	int i, j, k;
 	char *data = new char[SectorSize];
-	int nowSector;
 
 	printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-	nowSector = firstBlockSector;
-	while(nowSector != -1){
-		cout<<nowSector<<" ";
-		Block *block = new Block;
-		block->FetchFrom(nowSector);
-		nowSector = block->GetNextSector();
-		delete block;
-	}
-	// cout<<nowSector<<" ";
-
-	// for (i = 0; i < numSectors; i++)
-	// 	printf("%d ", dataSectors[i]);
-
+	for (i = 0; i < numSectors; i++)
+		printf("%d ", sectorMap[i]);
 	printf("\nFile contents:\n");
-	nowSector = firstBlockSector;
-	int nowByte = 0;
-	while(nowSector != -1 && (nowByte < numBytes)){
-		Block *block = new Block;
-		block->FetchFrom(nowSector);
-		char *data = block->GetData();
-		for (int i = 0; (i < BlockDataSize) && (nowByte < numBytes); i++, nowByte++)
+	// an inline file is printed as if it were a single block
+	for (i = k = 0; i < numSectors || (i == 0 && IsInline() && numBytes > 0); i++)
+	{
+		if (IsInline())
+			bcopy(inlineData, data, numBytes);
+		else
+			kernel->synchDisk->ReadSector(sectorMap[i], data);
+		for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++)
 		{
-			// printf("%c", block->GetData(i));
-			if ('\040' <= data[i] && data[i] <= '\176') // isprint(data[j])
-				printf("%c", data[i]);
+			if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
+				printf("%c", data[j]);
 			else
-				printf("\\%x", (unsigned char)data[i]);
+				printf("\\%x", (unsigned char)data[j]);
 		}
-		nowSector = block->GetNextSector();
 		printf("\n");
 	}
-	
-
-	// for (i = k = 0; i < numSectors; i++)
-	// {
-	// 	kernel->synchDisk->ReadSector(dataSectors[i], data);
-	// 	for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++)
-	// 	{
-	// 		if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
-	// 			printf("%c", data[j]);
-	// 		else
-	// 			printf("\\%x", (unsigned char)data[j]);
-	// 	}
-	// 	printf("\n");
-	// }
 	delete[] data;
 }
-
-int FileHeader::GetFirstBlockSector(){
-	return firstBlockSector;
-}
\ No newline at end of file
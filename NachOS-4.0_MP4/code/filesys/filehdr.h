@@ -17,50 +17,60 @@
 #include "disk.h"
 #include "pbitmap.h"
 
-// #define NumDirect ((SectorSize - 2 * sizeof(int)) / sizeof(int))
-// #define MaxFileSize (NumDirect * SectorSize)
+// mp4
+// A file header holds NumDirect direct sector pointers, plus one singly
+// indirect and one doubly indirect index sector.  Each index sector holds
+// NumIndirect sector numbers, so any byte of the file can be located by
+// reading at most two index sectors.
+#define NumDirect ((int)((SectorSize - 4 * sizeof(int)) / sizeof(int)))
+#define NumIndirect ((int)(SectorSize / sizeof(int)))
+#define MaxFileSectors (NumDirect + NumIndirect + NumIndirect * NumIndirect)
+#define MaxFileSize (MaxFileSectors * SectorSize)
 
-#define BlockDataSize (SectorSize - 2 * sizeof(int))
-#define BlockLength (BlockDataSize / sizeof(int))
+// mp4
+// A file of up to MaxInlineSize bytes keeps its data in the header
+// sector itself, where the sector pointers would go, and has no data
+// blocks at all.  It moves to data blocks as soon as it grows larger.
+#define MaxInlineSize ((int)(SectorSize - 2 * sizeof(int)))
 
 // The following class defines the Nachos "file header" (in UNIX terms,
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks.
+// The file header is organized as a table of pointers to data blocks,
+// followed by a pointer to a singly indirect block (a sector full of
+// pointers to data blocks) and a pointer to a doubly indirect block
+// (a sector full of pointers to singly indirect blocks).
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  With double indirection, this limits the
+// maximum file length to MaxFileSize (a bit over 135K bytes).
+//
+// A small file is "inline": it has no data blocks (numSectors is 0),
+// and its bytes are stored in the header sector in place of the
+// sector pointers.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
 
 // mp4
-class Block{
+// An index sector of the file header: a table of NumIndirect sector
+// numbers, filling exactly one disk sector.  Unused entries are -1.
+class IndirectBlock
+{
 public:
-	Block();
-	Block(int nowSector, int newsector);
-	~Block();
-
-	void FetchFrom(int sectorNumber);
-	void WriteBack();
-	
-	int GetBlockSector();
-	void SetBlockSector(int nowSector);
+	IndirectBlock();
+	~IndirectBlock();
 
-	int GetNextSector();
-	void SetNextSector(int newSector);
+	void FetchFrom(int sectorNumber); // Read the index sector from disk
+	void WriteBack(int sectorNumber); // Write the index sector to disk
 
-	char *GetData();
-	bool SetNext(int newSector);
+	int GetSector(int index);			   // Return the "index"th entry
+	void SetSector(int index, int sector); // Change the "index"th entry
 
 private:
-	int blockSector;
-	int nextBlockSector;
-	int data[BlockLength];
+	int dataSectors[NumIndirect];
 };
 
 class FileHeader
@@ -73,6 +83,10 @@ public:
 	bool Allocate(PersistentBitmap *bitMap, int fileSize); // Initialize a file header,
 														   //  including allocating space
 														   //  on disk for the file data
+	bool Extend(PersistentBitmap *bitMap, int newSize);	   // Grow the file, allocating
+														   //  the new data blocks
+	int SectorsToGrow(int newSize);						   // Free sectors Extend would
+														   //  take to reach newSize
 	void Deallocate(PersistentBitmap *bitMap);			   // De-allocate this file's
 														   //  data blocks
 
@@ -80,14 +94,18 @@ public:
 	void WriteBack(int sectorNumber); // Write modifications to file header
 									  //  back to disk
 
-	void ByteToSectorAndNextSector(int offset, int *a, int *b); // Convert a byte offset into the file
+	int ByteToSector(int offset); // Convert a byte offset into the file
 								  // to the disk sector containing
 								  // the byte
 
 	int FileLength(); // Return the length of the file
 					  // in bytes
 
-	int GetFirstBlockSector();
+	bool IsInline() { return numSectors == 0; } // Data kept in the header?
+	void ReadInline(char *into, int numBytes, int position);
+	void WriteInline(char *from, int numBytes, int position);
+										// Copy the data of an inline file;
+										// WriteBack makes a write stick
 
 	void Print(); // Print the contents of the file.
 
@@ -101,16 +119,31 @@ private:
 		In order to implement a data structure, you will need to add some "in-core" data
 		to maintain data structure.
 		
-		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
-		written to a sector on disk.
-		In-core part - none
+		Disk Part - numBytes, numSectors, dataSectors, singleIndirectSector,
+		doubleIndirectSector occupy exactly 128 bytes and will be
+		written to a sector on disk.  For an inline file, inlineData
+		takes the place of the last three.
+		In-core part - sectorMap
 		
 	*/
-	int firstBlockSector;
 	int numBytes;				// Number of bytes in the file
 	int numSectors;				// Number of data blocks in the file
-
-	// int dataSectors[NumDirect]; // Disk sector numbers for each data block in the file
+	int dataSectors[NumDirect]; // Disk sector numbers for the first
+								// NumDirect data blocks in the file
+	int singleIndirectSector;	// Index sector for the next NumIndirect
+								// data blocks, or -1
+	int doubleIndirectSector;	// Index sector of index sectors for
+								// the rest of the file, or -1
+
+	char inlineData[MaxInlineSize]; // Contents of an inline file; stored
+									// on disk over dataSectors and the
+									// two index sector numbers
+
+	int *sectorMap; // In-core only: disk sector of every data block,
+					// built once from the index sectors so that
+					// ByteToSector never touches the disk
+
+	void BuildSectorMap(); // Rebuild sectorMap from the index sectors
 };
 
 #endif // FILEHDR_H
@@ -31,10 +31,9 @@
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
+//	   a file's data blocks are allocated when it is created, and
+//	    when the bytes written past its end are flushed
+//	   files cannot be bigger than MaxFileSize (cf. filehdr.h)
 //	   there is no attempt to make the system robust to failures
 //	    (if Nachos exits in the middle of an operation that modifies
 //	    the file system, it may corrupt the disk)
@@ -51,15 +50,16 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "synchdisk.h"
+#include "main.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 0
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; the directory grows
+// as files are added to it.
 #define FreeMapFileSize (NumSectors / BitsInByte)
 
 
@@ -70,6 +70,10 @@
 //	an empty directory, and a bitmap of free sectors (with almost but
 //	not all of the sectors marked as free).
 //
+//	The new bitmap, directory and their headers are laid out in host
+//	memory (see SynchDisk::BeginBulkWrite), and reach the disk as one
+//	request once they are complete.
+//
 //	If format = FALSE, we just have to open the files
 //	representing the bitmap and the directory.
 //
@@ -78,20 +82,21 @@
 
 FileSystem::FileSystem(bool format)
 {
-    // initialize table
-    for(int i=0;i<MAX_NUM_FILE;i++){
-        openFileTable[i] = NULL;
+    for (int i = 0; i < DirectoryCacheSize; i++){
+        dirCacheSector[i] = -1;
     }
+    reservedSectors = 0;
 
     DEBUG(dbgFile, "Initializing the file system.");
     if (format)
     {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        freeMap = new PersistentBitmap(NumSectors);
+        directory = new Directory(NumDirEntries);
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
 
         DEBUG(dbgFile, "Formatting the file system.");
+        kernel->synchDisk->BeginBulkWrite();
 
         // First, allocate space for FileHeaders for the directory and bitmap
         // (make sure no one else grabs these!)
@@ -128,15 +133,14 @@ FileSystem::FileSystem(bool format)
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
         freeMap->WriteBack(freeMapFile); // flush changes to disk
         directory->WriteBack(directoryFile);
-
+        directory->FetchFrom(directoryFile); // only to remember the file
+        kernel->synchDisk->EndBulkWrite();
 
         if (debug->IsEnabled('f'))
         {
             freeMap->Print();
             directory->Print();
         }
-        delete freeMap;
-        delete directory;
         delete mapHdr;
         delete dirHdr;
     }
@@ -146,6 +150,9 @@ FileSystem::FileSystem(bool format)
         // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(RootDirectorySector);
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+        directory = new Directory(NumDirEntries);
+        directory->FetchFrom(directoryFile);
     }
 }
 
@@ -155,6 +162,12 @@ FileSystem::FileSystem(bool format)
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
+    for (int i = 0; i < DirectoryCacheSize && dirCacheSector[i] != -1; i++){
+        delete dirCache[i];
+        delete dirCacheFile[i];
+    }
+    delete directory;
+    delete freeMap;
     delete freeMapFile;
     delete directoryFile;
 }
@@ -162,14 +175,14 @@ FileSystem::~FileSystem()
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	The file gets "initialSize" bytes of space right away; it can
+//	grow later by being written past its end (see OpenFile::Flush).
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
-//	  Add the name to the directory
+//	  Add the name to the directory, growing it if it is full
 //	  Store the new file header on disk
 //	  Flush the changes to the bitmap and the directory back to disk
 //
@@ -178,8 +191,8 @@ FileSystem::~FileSystem()
 // 	Create fails if:
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file
+//	 	no room to grow the directory for the new entry
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
@@ -190,34 +203,32 @@ FileSystem::~FileSystem()
 
 bool FileSystem::CreateFile(char *name, int initialSize, int type)
 {
-    Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
 
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-
     if (directory->Find(name) != -1){
         printf("File is already in directory\n");
         success = FALSE; // file is already in directory
     }else{
-        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
         sector = freeMap->FindAndSet(); // find a sector to hold the file header
 
         if (sector == -1){
             printf("No free block for file header\n");
             success = FALSE; // no free block for file header
-        }else if (!directory->Add(name, sector, type)){
-            printf("No space in directory\n");
-            success = FALSE; // no space in directory
         }else{
             hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, initialSize)){
+            if (!hdr->Allocate(freeMap, initialSize) ||
+                freeMap->NumClear() < reservedSectors){
+                // mp4: what is set aside for unflushed tails is not free
                 printf("No space on disk for data\n");
                 success = FALSE; // no space on disk for data
+            }else if (!directory->Add(name, sector, type, freeMap)){
+                // mp4: added last, since a full directory is extended
+                // on disk as soon as it grows
+                printf("No space in directory\n");
+                success = FALSE; // no space in directory
             }else{
                 success = TRUE;
                 // everthing worked, flush all changes back to disk
@@ -227,18 +238,62 @@ bool FileSystem::CreateFile(char *name, int initialSize, int type)
                 // mp4 initilize new directory
                 if(type == 1){
                     OpenFile *openFile = new OpenFile(sector);
-                    Directory *directoryToBeCreated = new Directory(DirectoryFileSize);
+                    Directory *directoryToBeCreated = new Directory(NumDirEntries);
                     directoryToBeCreated->WriteBack(openFile);
+                    delete directoryToBeCreated;
+                    delete openFile;
                 }
             }
             delete hdr;
         }
-        delete freeMap;
+        if (!success)
+            freeMap->FetchFrom(freeMapFile); // undo any allocation
     }
-    delete directory;
     return success;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::ExtendFile
+// 	Grow an open file to "newSize" bytes, taking the space out of the
+//	bitmap of free sectors, and write the bitmap back.  Used when a
+//	file that was written past its end is flushed.
+//	Return FALSE if there is not enough free space.
+//
+//	"file" -- the open file to grow
+//	"newSize" -- its new length in bytes
+//----------------------------------------------------------------------
+
+bool FileSystem::ExtendFile(OpenFile *file, int newSize)
+{
+    if (!file->Extend(freeMap, newSize))
+        return FALSE;
+    freeMap->WriteBack(freeMapFile);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeSectors
+// 	Return the number of free sectors that have not been set aside
+//	for the unflushed tail of an open file (see OpenFile::WriteAt).
+//----------------------------------------------------------------------
+
+int FileSystem::FreeSectors()
+{
+    return freeMap->NumClear() - reservedSectors;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Reserve
+// 	Set aside "numSectors" free sectors for an open file to grow into
+//	when its tail is flushed, or give them back if it is negative.
+//----------------------------------------------------------------------
+
+void FileSystem::Reserve(int numSectors)
+{
+    reservedSectors += numSectors;
+    ASSERT(reservedSectors >= 0 && reservedSectors <= freeMap->NumClear());
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Open
 // 	Open a file for reading and writing.
@@ -251,18 +306,15 @@ bool FileSystem::CreateFile(char *name, int initialSize, int type)
 
 OpenFile * FileSystem::Open(char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
 
     DEBUG(dbgFile, "Opening file" << name);
-    directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
     if (sector >= 0){
         // cout<<"in\n";
         openFile = new OpenFile(sector); // name was found in directory
     }
-    delete directory;
     return openFile; // return NULL if not found
 }
 
@@ -277,29 +329,32 @@ OpenFile * FileSystem::Open(char *name)
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
+//	mp4: a file that is still open is not removed either, and FALSE
+//	is returned: its in-core inode would outlive its sectors, and be
+//	found again by a new file reusing its header sector.
+//
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
 bool FileSystem::Remove(char *name)
 {
-    Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
     int sector;
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
     if (sector == -1)
     {
-        delete directory;
         return FALSE; // file not found
     }
+    ForgetDirectory(sector); // in case it was one; the cache keeps it open
+    if (kernel->inodeTable->IsOpen(sector))
+    {
+        DEBUG(dbgFile, "Not removing open file " << name);
+        return FALSE;
+    }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-
     fileHdr->Deallocate(freeMap); // remove data blocks
     freeMap->Clear(sector);       // remove header block
     directory->Remove(name);
@@ -307,11 +362,20 @@ bool FileSystem::Remove(char *name)
     freeMap->WriteBack(freeMapFile);     // flush to disk
     directory->WriteBack(directoryFile); // flush to disk
     delete fileHdr;
-    delete directory;
-    delete freeMap;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::IsDirectory
+// 	Return TRUE if "name" is a directory, FALSE if it is a regular
+//	file or does not exist.
+//----------------------------------------------------------------------
+
+bool FileSystem::IsDirectory(char *name)
+{
+    return directory->IsDirectory(name);
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -319,20 +383,10 @@ bool FileSystem::Remove(char *name)
 // mp4
 void FileSystem::List(char *listName, bool recursiveFlag)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
     int sector = directory->Find(listName);
     // cout<<sector<<endl;
 
-    OpenFile *openFile = new OpenFile(sector);
-    Directory *listDirectory = new Directory(NumDirEntries);
-    listDirectory->FetchFrom(openFile);
-
-    listDirectory->List(recursiveFlag);
-
-    delete directory;
-    delete openFile;
-    delete listDirectory;
+    FetchDirectory(sector)->List(recursiveFlag);
 }
 
 //----------------------------------------------------------------------
@@ -349,8 +403,6 @@ void FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -361,60 +413,144 @@ void FileSystem::Print()
     dirHdr->Print();
 
     freeMap->Print();
-
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 }
 
-OpenFileId FileSystem::FS_OpenAFile(char *name){
-    OpenFileId num_openfile = -1;
-        for(int i=0;i<MAX_NUM_FILE;i++){
-            if(openFileTable[i] == NULL){
-                openFileTable[i] = Open(name);
-                num_openfile = i;
-                break;
-            }
-        }
+//----------------------------------------------------------------------
+// FileSystem::FetchDirectory
+// 	Return the in-core contents of the directory whose header is at
+//	"sector".  The root directory is always in memory; other
+//	directories are kept in a small cache ordered by last use, and
+//	only read from disk when they are not in it.  The result stays
+//	owned by the file system, and is only good until the next call,
+//	which may evict it; a caller that walks further down the tree
+//	must fetch it again afterwards.
+//
+//	"sector" -- the location of the directory's header on disk
+//----------------------------------------------------------------------
+
+Directory *FileSystem::FetchDirectory(int sector)
+{
+    int i;
 
-        if(num_openfile == -1){
-            cerr<<"Exceeding the file number limit.\n";
+    if (sector == RootDirectorySector)
+        return directory;
+
+    for (i = 0; i < DirectoryCacheSize - 1; i++){
+        if (dirCacheSector[i] == sector || dirCacheSector[i] == -1)
+            break;
+    }
+    Directory *dir = dirCache[i];
+    OpenFile *file = dirCacheFile[i];
+    if (dirCacheSector[i] != sector){
+        // a miss: evict the least recently used one, if the cache is full
+        if (dirCacheSector[i] != -1){
+            delete dir;
+            delete file;
         }
+        file = new OpenFile(sector);
+        dir = new Directory(NumDirEntries);
+        dir->FetchFrom(file);
+    }
+
+    // move it to the front
+    for (; i > 0; i--){
+        dirCacheSector[i] = dirCacheSector[i - 1];
+        dirCache[i] = dirCache[i - 1];
+        dirCacheFile[i] = dirCacheFile[i - 1];
+    }
+    dirCacheSector[0] = sector;
+    dirCache[0] = dir;
+    dirCacheFile[0] = file;
+    return dir;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetDirectory
+// 	Drop the directory whose header is at "sector" from the cache, as
+//	it is being removed; the sector may be reused for another file.
+//----------------------------------------------------------------------
+
+void FileSystem::ForgetDirectory(int sector)
+{
+    int i;
 
-        // cout<<"Now opening "<<num_openfile<<"-th file\n";
-    	return num_openfile;
+    for (i = 0; i < DirectoryCacheSize && dirCacheSector[i] != -1; i++){
+        if (dirCacheSector[i] == sector)
+            break;
+    }
+    if (i == DirectoryCacheSize || dirCacheSector[i] == -1)
+        return;
+
+    delete dirCache[i];
+    delete dirCacheFile[i];
+    for (; i < DirectoryCacheSize - 1; i++){
+        dirCacheSector[i] = dirCacheSector[i + 1];
+        dirCache[i] = dirCache[i + 1];
+        dirCacheFile[i] = dirCacheFile[i + 1];
+    }
+    dirCacheSector[DirectoryCacheSize - 1] = -1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FS_OpenAFile
+// 	Open a file for the running user program, and return the
+//	OpenFileId it knows it by, or -1 if the file does not exist or
+//	the program has too many files open.  Each address space has
+//	its own table of open files (see AddrSpace::AddFile).
+//
+//	"name" -- the text name of the file to be opened
+//----------------------------------------------------------------------
+
+OpenFileId FileSystem::FS_OpenAFile(char *name){
+    AddrSpace *space = kernel->currentThread->space;
+    OpenFile *openFile = Open(name);
+    OpenFileId id;
+
+    if(openFile == NULL) return -1;
+
+    id = space->AddFile(openFile);
+    if(id == -1){
+        cerr<<"Exceeding the file number limit.\n";
+        delete openFile;
+    }
+    return id;
 }
 
 int FileSystem::FS_ReadFile(char *buf, int size, OpenFileId id){
-    ASSERT(id >=0 && id < MAX_NUM_FILE);
+    OpenFile *openFile = kernel->currentThread->space->GetFile(id);
 
-    if(openFileTable[id] == NULL) return -1;
+    if(openFile == NULL) return -1;
     // cout<<"---FS Reading File---\n";
-    OpenFileId fid = openFileTable[id]->Read(buf, size);//(into,numbytes) into:the buffer to contain the data to be read from disk ,the number of bytes to transfer
-    // cout<<"---FS Reading File End---\n";
-    return size;
+    return openFile->Read(buf, size);//(into,numbytes) into:the buffer to contain the data to be read from disk ,the number of bytes to transfer
 }
 
 OpenFileId FileSystem::FS_WriteFile(char *buf, int size, OpenFileId id){
-    ASSERT(id >=0 && id < MAX_NUM_FILE);
+    OpenFile *openFile = kernel->currentThread->space->GetFile(id);
 
-    if(openFileTable[id] == NULL) return -1;
-    return openFileTable[id]->Write(buf, size);
+    if(openFile == NULL) return -1;
+    return openFile->Write(buf, size);
 }
 
+//----------------------------------------------------------------------
+// FileSystem::FS_CloseFile
+// 	Close a file of the running user program, releasing its
+//	OpenFileId and, with the OpenFile, its reference to the in-core
+//	inode.  Return 1 if it was open, 0 otherwise.
+//----------------------------------------------------------------------
+
 OpenFileId FileSystem::FS_CloseFile(OpenFileId id){
-    ASSERT(id >=0 && id < MAX_NUM_FILE);
+    OpenFile *openFile = kernel->currentThread->space->RemoveFile(id);
 
-    if(openFileTable[id] == NULL){
+    if(openFile == NULL){
         cerr<<"This FileId has no corresponding File.\n";
         return 0;
     }
 
-    openFileTable[id] = NULL;
+    delete openFile;
     return 1;
 }
 
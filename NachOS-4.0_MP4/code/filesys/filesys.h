@@ -36,8 +36,11 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
+#include "pbitmap.h"
 
-#define MAX_NUM_FILE 20
+#define DirectoryCacheSize 8 // mp4: subdirectories kept in memory
+
+class Directory;
 
 typedef int OpenFileId;
 
@@ -105,16 +108,40 @@ public:
 
 	bool Remove(char *name); // Delete a file (UNIX unlink)
 
+	bool IsDirectory(char *name); // mp4: whether "name" is a directory
+
+	bool ExtendFile(OpenFile *file, int newSize); // Allocate space for an
+												  // open file to grow
+	int FreeSectors();			  // Free sectors not set aside
+	void Reserve(int numSectors); // Set aside free sectors for a file
+								  // to grow into; negative to give
+								  // them back
+
 	void List(char *listName, bool recursiveFlag); // List all the files in the file system
 
 	void Print(); // List all the files and their contents
 
+	Directory *FetchDirectory(int sector); // mp4: in-core contents of the
+										   // directory whose header is
+										   // at "sector"
+
 private:
 	OpenFile *freeMapFile;// Bit map of free disk blocks,
 							 // represented as a file
+	PersistentBitmap *freeMap; // mp4: its contents, kept in memory
+	int reservedSectors;	   // mp4: free sectors set aside for the
+							   // unflushed tails of open files
 	OpenFile *directoryFile; // "Root" directory -- list of
 							 // file names, represented as a file
-	OpenFile *openFileTable[MAX_NUM_FILE];
+	Directory *directory;	 // mp4: its contents, kept in memory
+
+	// mp4: recently used subdirectories, most recent first; a free
+	// slot has sector -1
+	int dirCacheSector[DirectoryCacheSize];
+	Directory *dirCache[DirectoryCacheSize];
+	OpenFile *dirCacheFile[DirectoryCacheSize];
+
+	void ForgetDirectory(int sector); // Drop a removed directory
 };
 
 #endif // FILESYS
@@ -5,7 +5,15 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  It is kept in an in-core inode,
+//	shared by all the opens of the file (see InodeTable).
+//
+//	A file grows when it is written past its end.  Those bytes are
+//	kept in memory, and disk space for them is only allocated when
+//	the file is flushed or closed, in one piece for the final size.
+//	Enough free sectors are set aside as they are written, so a write
+//	the disk could not hold comes up short, instead of being lost at
+//	the flush.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -17,31 +25,41 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "filesys.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless the file is open
+//	already, in which case its in-core inode is shared.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector) //the location on disk of the file header for this file
 {
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = kernel->inodeTable->Get(sector);
+    hdr = inode->hdr;
+    hdrSector = sector;
     // hdr->Print();
     seekPosition = 0;
+    lastReadEnd = 0;
+    readAheadEnd = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	Bytes written past the end of the file are flushed first, into
+//	the room WriteAt set aside for them.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    bool flushed = Flush();
+
+    ASSERT(flushed);
+    kernel->inodeTable->Put(inode);
 }
 
 //----------------------------------------------------------------------
@@ -65,6 +83,10 @@ void OpenFile::Seek(int position)
 //
 //	Implemented using the more primitive ReadAt/WriteAt.
 //
+//	A Read that starts where the previous one stopped is taken as
+//	sequential access, and the next few data blocks are prefetched.
+//	Any other Read, as after a Seek, starts the read ahead over.
+//
 //	"into" -- the buffer to contain the data to be read from disk
 //	"from" -- the buffer containing the data to be written to disk
 //	"numBytes" -- the number of bytes to transfer
@@ -72,8 +94,14 @@ void OpenFile::Seek(int position)
 
 int OpenFile::Read(char *into, int numBytes)
 {
+    bool sequential = (seekPosition == lastReadEnd);
     int result = ReadAt(into, numBytes, seekPosition);
+    if (!sequential)
+        readAheadEnd = 0; // what was queued was for another stretch
     seekPosition += result;
+    lastReadEnd = seekPosition;
+    if (sequential)
+        ReadAhead();
     return result;
 }
 
@@ -84,6 +112,30 @@ int OpenFile::Write(char *into, int numBytes)
     return result;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Hand the data blocks following seekPosition, up to the read ahead
+//	window, to the disk's read ahead thread.  Blocks that were handed
+//	over by an earlier call are not queued again.
+//----------------------------------------------------------------------
+
+void OpenFile::ReadAhead()
+{
+    int window = kernel->synchDisk->ReadAheadWindow();
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int first = divRoundUp(seekPosition, SectorSize);
+    int last = min(first + window, numSectors);
+
+    if (hdr->IsInline())
+        return; // nothing but the header, which is already here
+    if (first < readAheadEnd)
+        first = readAheadEnd;
+    for (int i = first; i < last; i++)
+        kernel->synchDisk->Prefetch(hdr->ByteToSector(i * SectorSize));
+    if (last > readAheadEnd)
+        readAheadEnd = last;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -95,13 +147,25 @@ int OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   A sector that is only partially part of the request is read into
+//	   a one-sector buffer, and we only copy the part we are interested
+//	   in.  Whole sectors are read straight into the caller's buffer.
 //	For WriteAt:
 //	   We must first read in any sectors that will be partially written,
 //	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   in the data that will be modified, and write them back.  Whole
+//	   sectors are written straight from the caller's buffer.
+//
+//	Whole sectors of the file that are also consecutive on disk are
+//	read or written together, with one multi-sector request per run.
+//
+//	The data of an inline file is in the header, so it is copied
+//	straight out of it, and a write only has to rewrite the header.
+//
+//	The part of a write that falls past the allocated end of the file
+//	goes to the in-memory tail instead (see Flush), and extends the
+//	file, up to MaxFileSize, and as far as there is room on disk for
+//	(see ReserveTail).  Reads see the tail too.
 //
 //	"into" -- the buffer to contain the data to be read from disk
 //	"from" -- the buffer containing the data to be written to disk
@@ -110,121 +174,411 @@ int OpenFile::Write(char *into, int numBytes)
 //			read/written
 //----------------------------------------------------------------------
 
-// mp4
 int OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    // cout<<"---Reading At---\n";
-    int fileLength = hdr->FileLength();
-    int firstSectorIndex, lastSectorIndex, numSectors;
-    char *buf;
+    int fileLength = Length();
+    int allocated = hdr->FileLength();
+    int i, count, firstSector, lastSector, result;
+    char buf[SectorSize];
 
     if ((numBytes <= 0) || (position >= fileLength))
         return 0; // check request
     if ((position + numBytes) > fileLength)
         numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
-
-    firstSectorIndex = divRoundDown(position, BlockDataSize);
-    lastSectorIndex = divRoundDown(position + numBytes - 1, BlockDataSize);
-    numSectors = 1 + lastSectorIndex - firstSectorIndex;
-
-    // read in all the full and partial sectors that we need
-    // modification
-    buf = new char[numSectors * BlockDataSize];
-    int nowSector, newSector;
-    for (int i = firstSectorIndex; i <= lastSectorIndex; i++){
-        hdr->ByteToSectorAndNextSector(i * BlockDataSize, &nowSector, &newSector);
-        Block *block = new Block;
-        block->FetchFrom(nowSector);
-        // cout<<"Block:\n NowSector: "<<block->GetBlockSector()<<"\n NextSector: "<<block->GetNextSector()<<endl;
-        char *data = block->GetData();
-        bcopy(data, &buf[(i - firstSectorIndex) * BlockDataSize], BlockDataSize);
-        // cout<<"Compare: "<<strncmp(data, &buf[(i - firstSectorIndex) * BlockDataSize], BlockDataSize)<<endl;
+    result = numBytes;
+    if (position + numBytes > allocated)
+    { // the end of the range is still in the tail
+        int start = max(position, allocated);
+        bcopy(inode->tail + (start - allocated), into + (start - position),
+              position + numBytes - start);
+        numBytes = start - position;
+        if (numBytes == 0)
+            return result;
+    }
+    if (hdr->IsInline())
+    {
+        hdr->ReadInline(into, numBytes, position);
+        return result;
     }
-        // kernel->synchDisk->ReadSector(hdr->ByteToSector(i * BlockDataSize),
-        //                               &buf[(i - firstSectorIndex) * BlockDataSize]);
-    // copy the part we want
-    bcopy(&buf[position - (firstSectorIndex * BlockDataSize)], into, numBytes);
 
-    // cout<<"---Reading At End---\n";
+    firstSector = divRoundDown(position, SectorSize);
+    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
 
-    delete[] buf;
-    
-    return numBytes;
+    for (i = firstSector; i <= lastSector; i += count)
+    {
+        int start = i * SectorSize; // offset of sector i in the file
+        int sector = hdr->ByteToSector(start);
+
+        count = WholeSectors(i, lastSector, position, numBytes);
+        if (count == 0)
+        { // copy the part we want out of a partial sector
+            int from = max(position, start);
+            int to = min(position + numBytes, start + SectorSize);
+            kernel->synchDisk->ReadSector(sector, buf);
+            bcopy(&buf[from - start], into + (from - position), to - from);
+            count = 1;
+        }
+        else
+            kernel->synchDisk->ReadSectors(sector, count,
+                                           into + (start - position));
+    }
+    return result;
 }
 
-// mp4
 int OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    // cout<<"---Writing At---\n";
-    // cout<<"First Block "<<hdr->GetFirstBlockSector()<<endl;
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, count, firstSector, lastSector, result;
+    char buf[SectorSize];
 
-    if ((numBytes <= 0) || (position >= fileLength)) //mp4why?
-        return 0; // check requeston + numBytes) > fileLength)
-    if ((position + numBytes) > fileLength)
-        numBytes = fileLength - position;
+    if ((numBytes <= 0) || (position < 0) || (position >= MaxFileSize))
+        return 0; // check request
+    if ((position + numBytes) > MaxFileSize)
+        numBytes = MaxFileSize - position;
+    if (position + numBytes > fileLength)
+    { // write no more than the disk will have room for
+        numBytes = ReserveTail(position + numBytes) - position;
+        if (numBytes <= 0)
+            return 0; // disk full
+    }
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    result = numBytes;
+    if (position + numBytes > fileLength)
+    { // the part past the end waits in the tail
+        int start = max(position, fileLength);
+        WriteTail(from + (start - position), position + numBytes - start,
+                  start - fileLength);
+        numBytes = start - position;
+        if (numBytes == 0)
+            return result;
+    }
+    if (hdr->IsInline())
+    {
+        hdr->WriteInline(from, numBytes, position);
+        kernel->inodeTable->WriteBack(inode);
+        return result;
+    }
+
+    firstSector = divRoundDown(position, SectorSize);
+    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+
+    for (i = firstSector; i <= lastSector; i += count)
+    {
+        int start = i * SectorSize; // offset of sector i in the file
+        int sector = hdr->ByteToSector(start);
+
+        count = WholeSectors(i, lastSector, position, numBytes);
+        if (count == 0)
+        { // read in a partial sector, and copy in the bytes we change
+            int first = max(position, start);
+            int last = min(position + numBytes, start + SectorSize);
+            kernel->synchDisk->ReadSector(sector, buf);
+            bcopy(from + (first - position), &buf[first - start], last - first);
+            kernel->synchDisk->WriteSector(sector, buf);
+            count = 1;
+        }
+        else
+            kernel->synchDisk->WriteSectors(sector, count,
+                                            from + (start - position));
+    }
+    return result;
+}
 
-    firstSector = divRoundDown(position, BlockDataSize);
-    lastSector = divRoundDown(position + numBytes - 1, BlockDataSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * BlockDataSize];
-
-    memset(buf, 0, sizeof(char) * numSectors * BlockDataSize); //要將char buf字串陣列全部初始化為0,要設定的bytes數
-
-    firstAligned = (position == (firstSector * BlockDataSize)); //firstAligned is true if....
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * BlockDataSize));
-
-    // read in first and last sector, if they are to be partially modified
-    //mp4why
-    if (!firstAligned)
-        ReadAt(buf, BlockDataSize, firstSector * BlockDataSize);
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * BlockDataSize],
-               BlockDataSize, lastSector * BlockDataSize);
-    //mp4why
-    // copy in the bytes we want to change
-    bcopy(from, &buf[position - (firstSector * BlockDataSize)], numBytes);
-    //copy numBytes of SRC(from) to DEST
-
-    // modification
-    // write modified sectors back
-    int nowSector, newSector;
-    for (i = firstSector; i <= lastSector; i++){
-        hdr->ByteToSectorAndNextSector(i * BlockDataSize, &nowSector, &newSector);
-        //Return which disk sector is storing a particular byte within the file
-        
-        Block *block = new Block;
-        block->SetBlockSector(nowSector);
-        block->SetNextSector(newSector);
-        char *data = block->GetData();
-        bcopy(&buf[(i - firstSector) * BlockDataSize], data, BlockDataSize);//mp4why?
-        //Copy BlockDataSize bytes of &buf[(i - firstSector) * BlockDataSize] to data
-        // cout<<"Compare: "<<strncmp(data, &buf[(i - firstSector) * BlockDataSize], BlockDataSize)<<endl;
-        //cout<<"Block:\n NowSector: "<<block->GetBlockSector()<<"\n NextSector: "<<block->GetNextSector()<<endl;
-        block->WriteBack();
-        //Write the contents of a buffer into a disk sector.  Return only after the data has been written.
-        //("sectorNumber" -- the disk sector to be written,"data" -- the new contents of the disk sector)
+//----------------------------------------------------------------------
+// OpenFile::WholeSectors
+// 	Return how many sectors, starting with sector "first" of the file
+//	and ending by "last", lie wholly inside the request and follow
+//	each other on disk.  Return 0 if sector "first" is only partly
+//	inside the request.
+//
+//	"position", "numBytes" -- the range of the file being transferred
+//----------------------------------------------------------------------
+
+int OpenFile::WholeSectors(int first, int last, int position, int numBytes)
+{
+    int end = position + numBytes;
+    int sector = hdr->ByteToSector(first * SectorSize);
+    int count;
+
+    if (first * SectorSize < position || (first + 1) * SectorSize > end)
+        return 0;
+    for (count = 1; first + count <= last; count++)
+    {
+        if ((first + count + 1) * SectorSize > end ||
+            hdr->ByteToSector((first + count) * SectorSize) != sector + count)
+            break;
     }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReserveTail
+// 	Set aside enough free sectors for the file to grow to "end" bytes
+//	when its tail is flushed.  If there are not that many, the end is
+//	brought back a sector at a time until there are.  Return the end
+//	that room was set aside for; no less than the allocated length.
+//----------------------------------------------------------------------
+
+int OpenFile::ReserveTail(int end)
+{
+    int fileLength = hdr->FileLength();
+    int room = kernel->fileSystem->FreeSectors() + inode->reserved;
+    int needed;
 
-    delete[] buf;
-    // cout<<"---Writing At End---\n";
-    return numBytes;
+    while (end > fileLength && hdr->SectorsToGrow(end) > room)
+        end = max((divRoundUp(end, SectorSize) - 1) * SectorSize, fileLength);
+    needed = hdr->SectorsToGrow(end);
+    if (needed > inode->reserved)
+    {
+        kernel->fileSystem->Reserve(needed - inode->reserved);
+        inode->reserved = needed;
+    }
+    return end;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteTail
+// 	Copy bytes written past the allocated end of the file into the
+//	tail, doubling its size as needed.  A gap between the old end
+//	of the file and the new bytes reads as zeroes.
+//
+//	"from" -- the buffer containing the data
+//	"numBytes" -- the number of bytes to copy
+//	"offset" -- where they go, relative to the allocated end
+//----------------------------------------------------------------------
+
+void OpenFile::WriteTail(char *from, int numBytes, int offset)
+{
+    int end = offset + numBytes;
+
+    if (end > inode->tailSize)
+    {
+        int size = (inode->tailSize > 0) ? inode->tailSize : SectorSize;
+        while (size < end)
+            size *= 2;
+        char *newTail = new char[size];
+        memset(newTail, 0, size);
+        if (inode->tail != NULL)
+        {
+            bcopy(inode->tail, newTail, inode->tailLength);
+            delete[] inode->tail;
+        }
+        inode->tail = newTail;
+        inode->tailSize = size;
+    }
+    bcopy(from, inode->tail + offset, numBytes);
+    if (end > inode->tailLength)
+        inode->tailLength = end;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Flush
+// 	Give the bytes written past the end of the file a place on disk.
+//	The file is extended to its final size at once, so the new data
+//	blocks can be allocated as one contiguous run, and the tail is
+//	then written to them.  The room set aside for the tail is given
+//	back, since it is now allocated.
+//
+//	Return FALSE if there is no room for them; the tail is kept.
+//----------------------------------------------------------------------
+
+bool OpenFile::Flush()
+{
+    int fileLength = hdr->FileLength();
+    char *data = inode->tail;
+    int numBytes = inode->tailLength;
+
+    if (numBytes == 0)
+        return TRUE;
+    if (!kernel->fileSystem->ExtendFile(this, fileLength + numBytes))
+        return FALSE;
+    kernel->fileSystem->Reserve(-inode->reserved);
+    inode->reserved = 0;
+
+    inode->tail = NULL;
+    inode->tailLength = inode->tailSize = 0;
+    WriteAt(data, numBytes, fileLength);
+    delete[] data;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::Length
-// 	Return the number of bytes in the file.
+// 	Return the number of bytes in the file, including any that have
+//	not been flushed yet.
 //----------------------------------------------------------------------
 
 int OpenFile::Length()
 {
-    return hdr->FileLength();
+    return hdr->FileLength() + inode->tailLength;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Extend
+// 	Grow the file to "newSize" bytes, allocating the new data blocks
+//	out of "freeMap", and write the changed header back to disk.
+//	Return FALSE if there is not enough room; the file is unchanged.
+//	Sectors set aside for the tails of other files are not room.
+//
+//	The caller is responsible for writing "freeMap" back.
+//----------------------------------------------------------------------
+
+bool OpenFile::Extend(PersistentBitmap *freeMap, int newSize)
+{
+    if (hdr->SectorsToGrow(newSize) >
+        kernel->fileSystem->FreeSectors() + inode->reserved)
+        return FALSE;
+    if (!hdr->Extend(freeMap, newSize))
+        return FALSE;
+    kernel->inodeTable->WriteBack(inode);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty table of in-core inodes.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    for (int i = 0; i < InodeTableBuckets; i++)
+        buckets[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the table, along with the inodes of files that were
+//	never closed.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    for (int i = 0; i < InodeTableBuckets; i++)
+    {
+        while (buckets[i] != NULL)
+        {
+            Inode *inode = buckets[i];
+            buckets[i] = inode->next;
+            if (inode->tail != NULL)
+                delete[] inode->tail;
+            delete inode->hdr;
+            delete inode;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the inode of the file whose header is at "sector", and
+//	take a reference to it.  The header is only read from disk when
+//	the file is not open already.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+Inode *InodeTable::Get(int sector)
+{
+    Inode **chain = &buckets[sector % InodeTableBuckets];
+    Inode *inode;
+
+    for (inode = *chain; inode != NULL; inode = inode->next)
+    {
+        if (inode->sector == sector)
+        {
+            inode->refCount++;
+            return inode;
+        }
+    }
+
+    inode = new Inode;
+    inode->sector = sector;
+    inode->hdr = new FileHeader;
+    inode->hdr->FetchFrom(sector);
+    inode->refCount = 1;
+    inode->tail = NULL;
+    inode->tailLength = 0;
+    inode->tailSize = 0;
+    inode->reserved = 0;
+    inode->next = *chain;
+    *chain = inode;
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	Drop a reference to "inode"; with the last one, the file is no
+//	longer open, and the inode is freed, along with any tail that
+//	could not be flushed.
+//----------------------------------------------------------------------
+
+void InodeTable::Put(Inode *inode)
+{
+    Inode **link = &buckets[inode->sector % InodeTableBuckets];
+
+    ASSERT(inode->refCount > 0);
+    if (--inode->refCount > 0)
+        return;
+
+    while (*link != inode)
+        link = &(*link)->next;
+    *link = inode->next;
+    if (inode->tail != NULL)
+        delete[] inode->tail;
+    delete inode->hdr;
+    delete inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::IsOpen
+// 	Return TRUE if the file whose header is at "sector" has an inode,
+//	that is, if some OpenFile of it has not been closed.
+//----------------------------------------------------------------------
+
+bool InodeTable::IsOpen(int sector)
+{
+    Inode *inode;
+
+    for (inode = buckets[sector % InodeTableBuckets]; inode != NULL;
+         inode = inode->next)
+    {
+        if (inode->sector == sector)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::WriteBack
+// 	Write the header of an open file back to disk, after it changed.
+//	This is the only place the header of an open file is written, so
+//	there is a single copy of it to write.
+//----------------------------------------------------------------------
+
+void InodeTable::WriteBack(Inode *inode)
+{
+    inode->hdr->WriteBack(inode->sector);
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Flush
+// 	Give the bytes written past the end of every open file a place on
+//	disk, as closing the file would.  Called when Nachos halts, since
+//	the files a program leaves open are never closed then.
+//----------------------------------------------------------------------
+
+void InodeTable::Flush()
+{
+    for (int i = 0; i < InodeTableBuckets; i++)
+    {
+        for (Inode *inode = buckets[i]; inode != NULL; inode = inode->next)
+        {
+            if (inode->tailLength == 0)
+                continue;
+            OpenFile *file = new OpenFile(inode->sector); // shares inode
+            delete file; // flushes the tail
+        }
+    }
 }
 
 #endif //FILESYS_STUB
@@ -74,13 +74,63 @@ private:
 
 #else // FILESYS
 class FileHeader;
+class PersistentBitmap;
+
+// mp4
+// The following class defines an in-core "inode": the state of a file
+// that is shared by every OpenFile of it -- its header, and the bytes
+// written past its allocated end (see OpenFile::Flush).  All the opens
+// of one file see the same length and the same data.
+//
+// Inodes live in the kernel-wide inode table, keyed by the sector
+// holding the header, and are freed when their last OpenFile closes.
+
+class Inode
+{
+public:
+	int sector;		  // Disk sector holding the header
+	FileHeader *hdr;  // The header, read in once
+	int refCount;	  // Number of OpenFiles using it
+
+	char *tail;		  // Bytes written past the allocated end of the
+					  // file, waiting for Flush; NULL if none
+	int tailLength;	  // Number of bytes in tail
+	int tailSize;	  // Number of bytes tail has room for
+	int reserved;	  // Free sectors set aside for flushing it
+
+	Inode *next;	  // Next inode in the same hash chain
+};
+
+#define InodeTableBuckets 64 // hash chains
+
+class InodeTable
+{
+public:
+	InodeTable();  // Initialize an empty table
+	~InodeTable(); // De-allocate the table, and any inode left
+
+	Inode *Get(int sector); // Return the inode of the file whose header
+							//  is at "sector", reading the header if it
+							//  is not open yet; take a reference
+	void Put(Inode *inode); // Drop a reference, freeing the inode
+							//  with the last one
+	bool IsOpen(int sector); // Whether the file whose header is at
+							 //  "sector" is open
+
+	void WriteBack(Inode *inode); // Write a changed header to disk
+
+	void Flush(); // Flush the tail of every open file
+
+private:
+	Inode *buckets[InodeTableBuckets];
+};
 
 class OpenFile
 {
 public:
 	OpenFile(int sector); // Open a file whose header is located
 						  // at "sector" on the disk
-	~OpenFile();		  // Close the file
+	~OpenFile();		  // Close the file, after a Flush
 
 	void Seek(int position); // Set the position from which to
 							 // start reading/writing -- UNIX lseek
@@ -101,9 +151,32 @@ public:
 				  // than the UNIX idiom -- lseek to
 				  // end of file, tell, lseek back
 
+	bool Extend(PersistentBitmap *freeMap, int newSize); // Grow the file to
+														 // "newSize" bytes
+
+	bool Flush(); // Allocate space for, and write out, the
+				  // bytes written past the end of the file
+
 private:
-	FileHeader *hdr;  // Header for this file
+	Inode *inode;	  // State shared with other opens of the file
+	FileHeader *hdr;  // Header for this file, that is, inode->hdr
+	int hdrSector;	  // Disk sector holding the header
 	int seekPosition; // Current position within the file
+	int lastReadEnd;  // Where the previous Read stopped; a Read
+					  // starting there is sequential
+	int readAheadEnd; // Data blocks before this one have already
+					  // been handed to the read ahead thread,
+					  // since the last non-sequential Read
+
+	void ReadAhead(); // Prefetch the blocks after seekPosition
+	int WholeSectors(int first, int last, int position, int numBytes);
+					  // Length of the run of whole, consecutive
+					  // sectors that starts at sector "first"
+	void WriteTail(char *from, int numBytes, int offset); // Copy into tail,
+														  // growing it
+	int ReserveTail(int end); // Set aside room on disk for the file
+							  // to grow to "end" bytes, or as far
+							  // as there is room for
 };
 
 #endif // FILESYS
@@ -7,7 +7,14 @@
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "debug.h"
 #include "pbitmap.h"
+#include "disk.h"
+
+// Number of sectors of the bitmap file holding the bits of "numWords"
+// words
+#define BitmapSectors(numWords) \
+    divRoundUp((numWords) * (int)sizeof(unsigned int), SectorSize)
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -16,11 +23,16 @@
 //
 //	"numItems" is the number of bits in the bitmap.
 //
-//      This constructor does not initialize the bitmap from a disk file
+//      This constructor does not initialize the bitmap from a disk file,
+//	so all of it counts as changed
 //----------------------------------------------------------------------
 
 PersistentBitmap::PersistentBitmap(int numItems) : Bitmap(numItems)
 {
+    nextFit = 0;
+    dirty = new Bitmap(BitmapSectors(numWords));
+    for (int i = 0; i < BitmapSectors(numWords); i++)
+        dirty->Mark(i);
 }
 
 //----------------------------------------------------------------------
@@ -41,6 +53,8 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems) : Bitmap(numIte
     // but we will just overwrite that with the contents of the
     // map found in the file
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    nextFit = 0;
+    dirty = new Bitmap(BitmapSectors(numWords));
 }
 
 //----------------------------------------------------------------------
@@ -50,11 +64,13 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems) : Bitmap(numIte
 
 PersistentBitmap::~PersistentBitmap()
 {
+    delete dirty;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::FetchFrom
 // 	Initialize the contents of a persistent bitmap from a Nachos file.
+//	Changes not written back yet are dropped.
 //
 //	"file" is the place to read the bitmap from
 //----------------------------------------------------------------------
@@ -62,16 +78,172 @@ PersistentBitmap::~PersistentBitmap()
 void PersistentBitmap::FetchFrom(OpenFile *file)
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    for (int i = 0; i < BitmapSectors(numWords); i++)
+        dirty->Clear(i);
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
+//	Only the sectors of the file holding changed bits are written,
+//	each run of them with one WriteAt.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
 
 void PersistentBitmap::WriteBack(OpenFile *file)
 {
-    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int numSectors = BitmapSectors(numWords);
+    int length = numWords * sizeof(unsigned);
+
+    for (int i = 0; i < numSectors; i++)
+    {
+        if (!dirty->Test(i))
+            continue;
+        int count = 0;
+        for (; i + count < numSectors && dirty->Test(i + count); count++)
+            dirty->Clear(i + count);
+        int end = min((i + count) * SectorSize, length);
+        file->WriteAt((char *)map + i * SectorSize, end - i * SectorSize,
+                      i * SectorSize);
+        i += count;
+    }
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::Mark/Clear
+// 	Set/clear the "nth" bit, and remember which sector of the bitmap
+//	file has to be written back.
+//----------------------------------------------------------------------
+
+void PersistentBitmap::Mark(int which)
+{
+    Bitmap::Mark(which);
+    dirty->Mark(which / BitsInByte / SectorSize);
+}
+
+void PersistentBitmap::Clear(int which)
+{
+    Bitmap::Clear(which);
+    dirty->Mark(which / BitsInByte / SectorSize);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::NextClear
+// 	Return the number of the first clear bit at or after "from", or -1
+//	if there is none.  Words with every bit set are skipped whole.
+//----------------------------------------------------------------------
+
+int PersistentBitmap::NextClear(int from)
+{
+    for (int w = from / BitsInWord; w < numWords; w++)
+    {
+        unsigned int word = map[w];
+
+        if (w == from / BitsInWord) // ignore the bits before "from"
+            word |= (1u << (from % BitsInWord)) - 1;
+        if (word == ~0u)
+            continue;
+
+        int which = w * BitsInWord;
+        for (; word & 1; word >>= 1)
+            which++;
+        return (which < numBits) ? which : -1;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::NextSet
+// 	Return the number of the first set bit at or after "from", or
+//	numBits if there is none.  Words with every bit clear are skipped
+//	whole.
+//----------------------------------------------------------------------
+
+int PersistentBitmap::NextSet(int from)
+{
+    for (int w = from / BitsInWord; w < numWords; w++)
+    {
+        unsigned int word = map[w];
+
+        if (w == from / BitsInWord) // ignore the bits before "from"
+            word &= ~((1u << (from % BitsInWord)) - 1);
+        if (word == 0)
+            continue;
+
+        int which = w * BitsInWord;
+        for (; !(word & 1); word >>= 1)
+            which++;
+        return (which < numBits) ? which : numBits;
+    }
+    return numBits;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindAndSetRun
+// 	Find a run of consecutive clear bits, set them, and return the
+//	length of the run; "*start" is set to its first bit.  Return 0
+//	(and set "*start" to -1) if no bits are clear.
+//
+//	The search is next fit: it starts where the previous run ended,
+//	and wraps around.  The first run of "wanted" bits is taken; if
+//	there is none, the longest run found is taken instead, and the
+//	caller asks again for the rest.
+//
+//	"wanted" is the number of bits the caller would like
+//	"start" is where to return the first bit of the run
+//----------------------------------------------------------------------
+
+int PersistentBitmap::FindAndSetRun(int wanted, int *start)
+{
+    int best = -1;
+    int bestLength = 0;
+
+    ASSERT(wanted > 0);
+    for (int pass = 0; pass < 2 && bestLength < wanted; pass++)
+    {
+        int from = (pass == 0) ? nextFit : 0;
+        int to = (pass == 0) ? numBits : nextFit;
+
+        while (from < to)
+        {
+            int first = NextClear(from);
+            if (first == -1 || first >= to)
+                break;
+
+            int end = NextSet(first);
+            if (end - first > bestLength)
+            {
+                best = first;
+                bestLength = end - first;
+                if (bestLength >= wanted)
+                {
+                    bestLength = wanted;
+                    break;
+                }
+            }
+            from = end;
+        }
+    }
+
+    *start = best;
+    for (int i = 0; i < bestLength; i++)
+        Mark(best + i);
+    if (bestLength > 0)
+        nextFit = (best + bestLength) % numBits;
+    return bestLength;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindAndSet
+// 	Return the number of a clear bit, searching next fit, and set it.
+//	If no bits are clear, return -1.
+//----------------------------------------------------------------------
+
+int PersistentBitmap::FindAndSet()
+{
+    int which;
+
+    (void)FindAndSetRun(1, &which);
+    return which;
 }
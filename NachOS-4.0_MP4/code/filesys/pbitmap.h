@@ -6,6 +6,13 @@
 //    when it is created, or it can be initialized later using
 //    the FetchFrom method
 //
+//    As the map of free disk sectors, it also hands out runs of
+//    consecutive sectors, so that a file's data ends up contiguous
+//    on disk.
+//
+//    It remembers which sectors of its file hold bits that changed
+//    since it was read, and only writes those back.
+//
 // Copyright (c) 1992,1993,1995 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
@@ -30,7 +37,27 @@ public:
     ~PersistentBitmap(); // deallocate bitmap
 
     void FetchFrom(OpenFile *file); // read bitmap from the disk
-    void WriteBack(OpenFile *file); // write bitmap contents to disk
+    void WriteBack(OpenFile *file); // write changed parts to disk
+
+    void Mark(int which);  // Set/clear the "nth" bit, noting the
+    void Clear(int which); // sector of the file it is stored in
+
+    // mp4
+    int FindAndSetRun(int wanted, int *start); // Set a run of up to
+                                               // "wanted" clear bits,
+                                               // return its length
+    int FindAndSet(); // Set one clear bit, next fit
+
+private:
+    int nextFit; // In-core only: where the next search starts,
+                 // just past the last run handed out
+    Bitmap *dirty; // In-core only: sectors of the bitmap file
+                   // changed since the last FetchFrom/WriteBack
+
+    int NextClear(int from); // First clear bit at or after "from",
+                             // or -1
+    int NextSet(int from);   // First set bit at or after "from",
+                             // or numBits
 };
 
 #endif // PBITMAP_H
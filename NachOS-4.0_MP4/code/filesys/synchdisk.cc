@@ -5,10 +5,23 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries a semaphore to synchronize the interrupt
+//	handler with the thread waiting for it.  Because the physical
+//	disk can only handle one operation at a time, requests that
+//	arrive while it is busy are queued, and the interrupt handler
+//	starts the next one in elevator order.  The queue is protected
+//	by disabling interrupts, since the interrupt handler uses it.
+//
+//	Recently used sectors are kept in a write-back buffer cache,
+//	replaced in least-recently-used order.  A lock protects the
+//	cache.  It is released while a thread waits for the disk, so
+//	that other threads can use the cache and queue requests of
+//	their own; the cache entry being transferred is marked busy
+//	meanwhile.
+//
+//	Read-ahead is done by a separate kernel thread, which takes
+//	sector numbers off a queue and reads them into the cache, so
+//	that the thread that asked for them can go on running.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -16,38 +29,95 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "main.h"
+
+// Functions used by the HashTable of cached sectors
+static int
+CacheEntryKey(CacheEntry *entry)
+{
+    return entry->sector;
+}
+
+static unsigned
+SectorHash(int sector)
+{
+    return (unsigned)sector;
+}
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	"readAhead" -- how many sectors past a sequential read to prefetch;
+//		if 0, no read ahead thread is started
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(int readAhead)
 {
-    semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
+    entryReady = new Condition("synch disk entry ready");
     disk = new Disk(this);
+    current = NULL;
+    pending = NULL;
+    numPending = 0;
+    headSector = 0;
+
+    // every entry starts out unused, chained in array order
+    cache = new CacheEntry[CacheSize];
+    cacheTable = new HashTable<int, CacheEntry *>(CacheEntryKey, SectorHash);
+    for (int i = 0; i < CacheSize; i++)
+    {
+        cache[i].sector = -1;
+        cache[i].dirty = FALSE;
+        cache[i].prefetched = FALSE;
+        cache[i].busy = FALSE;
+        cache[i].prev = (i > 0) ? &cache[i - 1] : NULL;
+        cache[i].next = (i < CacheSize - 1) ? &cache[i + 1] : NULL;
+    }
+    mostRecent = &cache[0];
+    leastRecent = &cache[CacheSize - 1];
+
+    bulkImage = NULL;
+    bulkWritten = NULL;
+    bulkSectors = 0;
+
+    readAheadWindow = readAhead;
+    prefetchQueue = NULL;
+    if (readAheadWindow > 0)
+    {
+        prefetchQueue = new List<int>;
+        prefetchReady = new Condition("read ahead queue");
+        Thread *t = new Thread("read ahead", 1);
+        t->Fork(SynchDisk::ReadAheadWorker, this);
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
 //	abstraction.
+//
+//	Since the read ahead thread may be waiting on the prefetch queue,
+//	we don't deallocate the queue (cf. PostOfficeInput).
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
+    for (int i = 0; i < CacheSize; i++)
+        if (cache[i].sector != -1)
+            cacheTable->Remove(cache[i].sector);
+    delete cacheTable;
+    delete[] cache;
     delete disk;
+    delete entryReady;
     delete lock;
-    delete semaphore;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read.  Only a cache miss goes to the disk.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -55,16 +125,14 @@ SynchDisk::~SynchDisk()
 
 void SynchDisk::ReadSector(int sectorNumber, char *data)
 {
-    lock->Acquire(); // only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P(); // wait for interrupt
-    lock->Release();
+    ReadSectors(sectorNumber, 1, data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  The sector is
+//	only marked dirty in the cache; it reaches the disk when it is
+//	evicted or flushed.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -72,19 +140,642 @@ void SynchDisk::ReadSector(int sectorNumber, char *data)
 
 void SynchDisk::WriteSector(int sectorNumber, char *data)
 {
-    lock->Acquire(); // only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P(); // wait for interrupt
+    WriteSectors(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read a range of consecutive disk sectors into a buffer.  Return
+//	only after all of the data has been read.
+//
+//	Cached sectors are copied out of the cache.  Each run of sectors
+//	that miss (up to MaxTransferSectors long) gets cache entries and
+//	is read from the disk with a single request.
+//
+//	During a bulk write, sectors written since BeginBulkWrite come
+//	from the bulk image instead, as they are newer than the disk.
+//
+//	"firstSector" -- the first disk sector to read
+//	"numSectors" -- how many sectors to read
+//	"data" -- the buffer to hold them, numSectors * SectorSize bytes
+//----------------------------------------------------------------------
+
+void SynchDisk::ReadSectors(int firstSector, int numSectors, char *data)
+{
+    CacheEntry *run[MaxTransferSectors];
+    CacheEntry *entry;
+    int i = 0;
+
+    if (bulkImage != NULL && BulkRead(firstSector, numSectors, data))
+        return;
+
+    lock->Acquire();
+    while (i < numSectors)
+    {
+        entry = FindEntry(firstSector + i);
+        if (entry != NULL)
+        {
+            kernel->stats->numCacheHits++;
+            if (entry->prefetched)
+            {
+                kernel->stats->numPrefetchHits++;
+                entry->prefetched = FALSE;
+            }
+            bcopy(entry->data, data + i * SectorSize, SectorSize);
+            i++;
+            continue;
+        }
+
+        // claim entries for the run of sectors that are not cached;
+        // ClaimEntry returns NULL if it had to let go of the lock,
+        // in which case the run ends there and the rest is looked
+        // up again
+        int count = 0;
+        while (i + count < numSectors && count < MaxTransferSectors &&
+               !cacheTable->Find(firstSector + i + count, &entry))
+        {
+            entry = ClaimEntry(firstSector + i + count);
+            if (entry == NULL)
+                break;
+            entry->busy = TRUE;
+            run[count++] = entry;
+        }
+        if (count == 0)
+            continue;
+
+        kernel->stats->numCacheMisses += count;
+        FillEntries(run, count);
+        for (int j = 0; j < count; j++)
+            bcopy(run[j]->data, data + (i + j) * SectorSize, SectorSize);
+        i += count;
+    }
+    lock->Release();
+
+    if (bulkImage != NULL)
+        (void)BulkRead(firstSector, numSectors, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write a buffer into a range of consecutive disk sectors.  The
+//	sectors are only marked dirty in the cache, or during a bulk
+//	write, copied into the bulk image.
+//
+//	"firstSector" -- the first disk sector to be written
+//	"numSectors" -- how many sectors to write
+//	"data" -- the new contents, numSectors * SectorSize bytes
+//----------------------------------------------------------------------
+
+void SynchDisk::WriteSectors(int firstSector, int numSectors, char *data)
+{
+    CacheEntry *entry;
+
+    if (bulkImage != NULL)
+    {
+        BulkWrite(firstSector, numSectors, data);
+        return;
+    }
+
+    lock->Acquire();
+    for (int i = 0; i < numSectors; i++)
+    {
+        for (;;)
+        {
+            entry = FindEntry(firstSector + i);
+            if (entry != NULL)
+            {
+                kernel->stats->numCacheHits++;
+                break;
+            }
+            // the whole sector is overwritten, no need to read it first
+            entry = ClaimEntry(firstSector + i);
+            if (entry != NULL)
+            {
+                kernel->stats->numCacheMisses++;
+                break;
+            }
+        }
+        bcopy(data + i * SectorSize, entry->data, SectorSize);
+        entry->dirty = TRUE;
+        entry->prefetched = FALSE;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty sector in the cache back to the disk.  Called
+//	when Nachos halts, so that the disk image is complete.
+//
+//	Dirty sectors that follow each other on disk are written together,
+//	with one request per run.
+//----------------------------------------------------------------------
+
+void SynchDisk::Flush()
+{
+    CacheEntry *run[MaxTransferSectors];
+
+    lock->Acquire();
+    for (int i = 0; i < CacheSize; i++)
+    {
+        if (!cache[i].dirty || cache[i].busy)
+            continue;
+        WriteBackEntries(run, DirtyRun(&cache[i], run));
+        i--; // cache[i] may be in a later run, if this one was full
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::BeginBulkWrite
+// 	Start collecting writes in host memory, rather than in the cache.
+//	Used to lay out a new file system, whose sectors are all written
+//	once and are then best sent to the disk together.
+//----------------------------------------------------------------------
+
+void SynchDisk::BeginBulkWrite()
+{
+    ASSERT(bulkImage == NULL);
+    bulkSectors = MaxTransferSectors;
+    bulkImage = new char[bulkSectors * SectorSize];
+    bulkWritten = new bool[bulkSectors];
+    for (int i = 0; i < bulkSectors; i++)
+        bulkWritten[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::EndBulkWrite
+// 	Write the sectors collected since BeginBulkWrite to the disk, one
+//	request per run of consecutive sectors, however long.  The disk
+//	charges the usual seek and rotation time for each run.
+//
+//	Cached copies of those sectors are brought up to date, so that
+//	the cache and the disk agree afterwards.
+//----------------------------------------------------------------------
+
+void SynchDisk::EndBulkWrite()
+{
+    char *image = bulkImage;
+    CacheEntry *entry;
+
+    ASSERT(image != NULL);
+    bulkImage = NULL; // from here on, reads and writes use the cache
+
+    lock->Acquire();
+    for (int first = 0; first < bulkSectors; first++)
+    {
+        if (!bulkWritten[first])
+            continue;
+        int count = 0;
+        while (first + count < bulkSectors && bulkWritten[first + count])
+        {
+            entry = FindEntry(first + count);
+            if (entry != NULL)
+            {
+                bcopy(image + (first + count) * SectorSize, entry->data,
+                      SectorSize);
+                entry->dirty = FALSE;
+            }
+            count++;
+        }
+        DEBUG(dbgDisk, "Bulk write of " << count << " sectors at " << first);
+        DiskWrite(first, count, image + first * SectorSize);
+        first += count;
+    }
+    lock->Release();
+
+    delete[] image;
+    delete[] bulkWritten;
+    bulkWritten = NULL;
+    bulkSectors = 0;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::BulkRead
+// 	Copy out of the bulk image those sectors of a range that were
+//	written since BeginBulkWrite.
+//
+//	Returns TRUE if every sector of the range was; the rest of "data"
+//	is left alone.
+//----------------------------------------------------------------------
+
+bool SynchDisk::BulkRead(int firstSector, int numSectors, char *data)
+{
+    bool all = TRUE;
+
+    for (int i = 0; i < numSectors; i++)
+    {
+        int sector = firstSector + i;
+        if (sector < bulkSectors && bulkWritten[sector])
+            bcopy(bulkImage + sector * SectorSize, data + i * SectorSize,
+                  SectorSize);
+        else
+            all = FALSE;
+    }
+    return all;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::BulkWrite
+// 	Copy a range of sectors into the bulk image, doubling the image
+//	until it reaches the last of them.
+//----------------------------------------------------------------------
+
+void SynchDisk::BulkWrite(int firstSector, int numSectors, char *data)
+{
+    int end = firstSector + numSectors;
+
+    ASSERT(firstSector >= 0 && end <= NumSectors);
+    if (end > bulkSectors)
+    {
+        int size = bulkSectors;
+        while (size < end)
+            size *= 2;
+        char *image = new char[size * SectorSize];
+        bool *written = new bool[size];
+        bcopy(bulkImage, image, bulkSectors * SectorSize);
+        for (int i = 0; i < size; i++)
+            written[i] = (i < bulkSectors) ? bulkWritten[i] : FALSE;
+        delete[] bulkImage;
+        delete[] bulkWritten;
+        bulkImage = image;
+        bulkWritten = written;
+        bulkSectors = size;
+    }
+    bcopy(data, bulkImage + firstSector * SectorSize, numSectors * SectorSize);
+    for (int i = firstSector; i < end; i++)
+        bulkWritten[i] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Ask the read ahead thread to bring a sector into the cache.
+//	Returns without waiting for the disk; a sector that is already
+//	cached or queued is skipped.
+//
+//	"sectorNumber" -- the disk sector that will probably be read soon
+//----------------------------------------------------------------------
+
+void SynchDisk::Prefetch(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    if (prefetchQueue == NULL)
+        return;
+    lock->Acquire();
+    if (!cacheTable->Find(sectorNumber, &entry) &&
+        !prefetchQueue->IsInList(sectorNumber))
+    {
+        prefetchQueue->Append(sectorNumber);
+        prefetchReady->Signal(lock);
+    }
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchDisk::ReadAheadWorker
+// 	Body of the read ahead thread: forever take the next sector off
+//	the prefetch queue and read it into the cache, unless someone
+//	else got it there first.  A best effort: a sector whose entry
+//	could not be claimed at once is dropped.
+//
+//	"data" -- the SynchDisk, passed as a void * so that this can be
+//		forked as a thread
+//----------------------------------------------------------------------
+
+void SynchDisk::ReadAheadWorker(void *data)
+{
+    SynchDisk *synchDisk = (SynchDisk *)data;
+    CacheEntry *run[MaxTransferSectors];
+
+    for (;;)
+    {
+        CacheEntry *entry;
+        int count = 0;
+
+        synchDisk->lock->Acquire();
+        while (synchDisk->prefetchQueue->IsEmpty())
+            synchDisk->prefetchReady->Wait(synchDisk->lock);
+        int sectorNumber = synchDisk->prefetchQueue->RemoveFront();
+
+        // queued sectors that follow on disk are read in the same
+        // request; if ClaimEntry has to let go of the lock, the run
+        // ends there
+        while (count < MaxTransferSectors &&
+               !synchDisk->cacheTable->Find(sectorNumber + count, &entry))
+        {
+            entry = synchDisk->ClaimEntry(sectorNumber + count);
+            if (entry == NULL)
+                break;
+            entry->prefetched = TRUE;
+            entry->busy = TRUE;
+            run[count++] = entry;
+            if (synchDisk->prefetchQueue->IsEmpty() ||
+                synchDisk->prefetchQueue->Front() != sectorNumber + count)
+                break;
+            (void)synchDisk->prefetchQueue->RemoveFront();
+        }
+        if (count > 0)
+        {
+            kernel->stats->numPrefetches += count;
+            synchDisk->FillEntries(run, count);
+        }
+        synchDisk->lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FindEntry
+// 	Look up a sector in the cache.  On a hit, the entry becomes the
+//	most recently used one.  Return NULL on a miss.
+//
+//	If the entry is busy with a disk transfer, wait until it is done
+//	and look again, since it may have been given to another sector
+//	in the meantime.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::FindEntry(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    for (;;)
+    {
+        if (!cacheTable->Find(sectorNumber, &entry))
+            return NULL;
+        if (!entry->busy)
+            break;
+        entryReady->Wait(lock);
+    }
+    MoveToFront(entry);
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ClaimEntry
+// 	Take over the least recently used cache entry for "sectorNumber",
+//	which the caller has just failed to find.  The caller fills in
+//	the data.
+//
+//	If that entry is dirty, write its old contents back first, along
+//	with the dirty sectors around it, and return NULL: the lock was
+//	released during the write, so another thread may have cached
+//	"sectorNumber" by now, and the caller has to look again.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::ClaimEntry(int sectorNumber)
+{
+    CacheEntry *run[MaxTransferSectors];
+    CacheEntry *entry = leastRecent;
+
+    while (entry != NULL && entry->busy)
+        entry = entry->prev;
+    ASSERT(entry != NULL); // every entry busy: more threads than entries
+
+    if (entry->dirty)
+    {
+        WriteBackEntries(run, DirtyRun(entry, run));
+        return NULL;
+    }
+    if (entry->sector != -1)
+        cacheTable->Remove(entry->sector);
+    entry->sector = sectorNumber;
+    entry->dirty = FALSE;
+    entry->prefetched = FALSE;
+    cacheTable->Insert(entry);
+    MoveToFront(entry);
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DirtyRun
+// 	Gather the run of dirty, cached sectors that "entry" belongs to,
+//	ready for WriteBackEntries: from the start of the run, up to
+//	MaxTransferSectors of them, marked busy.  A long run may stop
+//	short of "entry" itself.  The caller holds the lock.
+//
+//	Returns the number of entries put in "run".
+//----------------------------------------------------------------------
+
+int SynchDisk::DirtyRun(CacheEntry *entry, CacheEntry **run)
+{
+    int first = entry->sector;
+    int count = 0;
+
+    // back up to the start of the run of dirty sectors
+    while (first > 0 && cacheTable->Find(first - 1, &entry) &&
+           entry->dirty && !entry->busy)
+        first--;
+
+    while (count < MaxTransferSectors && first + count < NumSectors &&
+           cacheTable->Find(first + count, &entry) &&
+           entry->dirty && !entry->busy)
+    {
+        entry->busy = TRUE;
+        run[count++] = entry;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MoveToFront
+// 	Unlink a cache entry from the LRU list, and put it back at the
+//	most recently used end.
+//----------------------------------------------------------------------
+
+void SynchDisk::MoveToFront(CacheEntry *entry)
+{
+    if (entry == mostRecent)
+        return;
+
+    entry->prev->next = entry->next;
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        leastRecent = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = mostRecent;
+    mostRecent->prev = entry;
+    mostRecent = entry;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FillEntries
+// 	Read the sectors of newly claimed, busy entries from the disk, in
+//	one request.  The entries hold consecutive sectors.  They stay
+//	busy until the data is there, so nobody else uses them meanwhile.
+//	The caller holds the lock.
+//----------------------------------------------------------------------
+
+void SynchDisk::FillEntries(CacheEntry **entries, int count)
+{
+    char *buffer = new char[count * SectorSize];
+
+    DiskRead(entries[0]->sector, count, buffer);
+    for (int i = 0; i < count; i++)
+    {
+        bcopy(buffer + i * SectorSize, entries[i]->data, SectorSize);
+        entries[i]->busy = FALSE;
+    }
+    entryReady->Broadcast(lock);
+    delete[] buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBackEntries
+// 	Write busy, dirty entries holding consecutive sectors to the disk,
+//	in one request, and mark them clean.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+void SynchDisk::WriteBackEntries(CacheEntry **entries, int count)
+{
+    char *buffer = new char[count * SectorSize];
+
+    for (int i = 0; i < count; i++)
+        bcopy(entries[i]->data, buffer + i * SectorSize, SectorSize);
+    DiskWrite(entries[0]->sector, count, buffer);
+    for (int i = 0; i < count; i++)
+    {
+        entries[i]->busy = FALSE;
+        entries[i]->dirty = FALSE;
+    }
+    entryReady->Broadcast(lock);
+    delete[] buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskRead/DiskWrite
+// 	Send a request for "count" consecutive sectors to the raw disk,
+//	and wait for it to finish.  The caller must hold the lock; it is
+//	released while waiting.
+//----------------------------------------------------------------------
+
+void SynchDisk::DiskRead(int sectorNumber, int count, char *data)
+{
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.count = count;
+    request.data = data;
+    request.writing = FALSE;
+    lock->Release();
+    Submit(&request);
+    lock->Acquire();
+}
+
+void SynchDisk::DiskWrite(int sectorNumber, int count, char *data)
+{
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.count = count;
+    request.data = data;
+    request.writing = TRUE;
+    lock->Release();
+    Submit(&request);
+    lock->Acquire();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Give a request to the disk if it is idle, or else queue it, and
+//	wait for the disk interrupt that says it is done.
+//
+//	Normally the thread just sleeps on the request's semaphore.  But
+//	when Nachos halts because the last thread finished, the cache is
+//	flushed with interrupts already disabled and no thread to switch
+//	to, so we roll simulated time forward to the interrupt ourselves.
+//----------------------------------------------------------------------
+
+void SynchDisk::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    request->done = FALSE;
+    request->semaphore = new Semaphore("disk request", 0);
+
+    kernel->stats->numQueuedRequests++;
+    kernel->stats->totalQueueDepth += numPending + (current != NULL);
+    if (current == NULL)
+    {
+        StartRequest(request);
+    }
+    else
+    { // keep the pending list sorted by sector
+        DiskRequest **link = &pending;
+        while (*link != NULL && (*link)->sector <= request->sector)
+            link = &(*link)->next;
+        request->next = *link;
+        *link = request;
+        numPending++;
+    }
+
+    if (oldLevel == IntOff)
+    {
+        while (!request->done)
+            kernel->interrupt->Idle();
+    }
+    (void)kernel->interrupt->SetLevel(oldLevel);
+    request->semaphore->P(); // wait for interrupt
+    delete request->semaphore;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRequest
+// 	Hand a request to the raw disk.  Interrupts are disabled.
+//----------------------------------------------------------------------
+
+void SynchDisk::StartRequest(DiskRequest *request)
+{
+    current = request;
+    headSector = request->sector + request->count - 1;
+    if (request->writing)
+        disk->WriteSectors(request->sector, request->count, request->data);
+    else
+        disk->ReadSectors(request->sector, request->count, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NextRequest
+// 	Remove and return the pending request to serve next: the one with
+//	the lowest sector at or beyond the disk head, or, if the head has
+//	passed them all, the lowest sector of all (C-LOOK).  Since the
+//	list is sorted, that is where the head sweeps next.
+//	Interrupts are disabled.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::NextRequest()
+{
+    DiskRequest **link = &pending;
+
+    while (*link != NULL && (*link)->sector < headSector)
+        link = &(*link)->next;
+    if (*link == NULL) // nothing ahead of the head, go back to the start
+        link = &pending;
+
+    DiskRequest *request = *link;
+    *link = request->next;
+    numPending--;
+    return request;
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Start the next pending request, so that
+//	the disk stays busy, then wake up the thread waiting for the one
+//	that just finished.
 //----------------------------------------------------------------------
 
 void SynchDisk::CallBack()
 {
-    semaphore->V();
+    DiskRequest *finished = current;
+
+    current = NULL;
+    if (pending != NULL)
+        StartRequest(NextRequest());
+    finished->done = TRUE;
+    finished->semaphore->V();
 }
@@ -14,6 +14,47 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "hash.h"
+#include "list.h"
+
+// mp4
+// Number of sectors kept in the buffer cache in front of the disk.
+const int CacheSize = 1024;
+
+// Most sectors a single disk request transfers: one track's worth.
+const int MaxTransferSectors = SectorsPerTrack;
+
+// One sector's worth of the buffer cache.  Entries are chained on a
+// doubly linked list, most recently used first, so that the least
+// recently used entry can be found (and evicted) in constant time.
+
+class CacheEntry
+{
+public:
+    int sector;              // disk sector held here, -1 if unused
+    bool dirty;              // modified since it was read from disk?
+    bool prefetched;         // brought in by read-ahead, not used yet?
+    bool busy;               // being read or written back; wait
+                             // on entryReady before touching it
+    CacheEntry *prev;        // more recently used neighbour
+    CacheEntry *next;        // less recently used neighbour
+    char data[SectorSize];   // contents of the sector
+};
+
+// A request waiting for, or being served by, the raw disk.  It lives
+// on the stack of the thread that issued it, until the disk is done.
+
+class DiskRequest
+{
+public:
+    int sector;              // first disk sector to transfer
+    int count;               // number of consecutive sectors
+    char *data;              // where the data comes from or goes to
+    bool writing;            // write request?
+    bool done;               // has the disk finished it?
+    Semaphore *semaphore;    // signalled when the request is done
+    DiskRequest *next;       // next pending request, by sector
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -25,12 +66,36 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Sectors are kept in a write-back buffer cache: a read of a cached
+// sector, or any write, does not touch the disk.  Dirty sectors go
+// to disk when they are evicted, or when Flush is called, together
+// with the dirty sectors that follow them on disk.
+//
+// A range of consecutive sectors can be read or written in one call;
+// the sectors that miss the cache are then read from the disk with
+// one multi-sector request per run.
+//
+// Sectors can also be prefetched into the cache: Prefetch queues the
+// sector for a "read ahead" kernel thread and returns at once, so the
+// caller keeps running while the disk works.
+//
+// While a new file system is being laid out, BeginBulkWrite switches
+// writes to a plain array in host memory instead; EndBulkWrite then
+// sends each run of written sectors to the disk as one request.
+//
+// Several threads can have requests outstanding at once.  The raw disk
+// still serves one at a time; the others wait in a queue that is
+// served in elevator (C-LOOK) order: the nearest sector at or beyond
+// the disk head goes next, wrapping around to the lowest sector.
 
 class SynchDisk : public CallBackObj
 {
 public:
-    SynchDisk();  // Initialize a synchronous disk,
-                  // by initializing the raw Disk.
+    SynchDisk(int readAhead); // Initialize a synchronous disk,
+                              // by initializing the raw Disk.
+                              // Read ahead up to "readAhead"
+                              // sectors of sequential files.
     ~SynchDisk(); // De-allocate the synch disk data
 
     void ReadSector(int sectorNumber, char *data);
@@ -41,16 +106,82 @@ public:
     // then wait until the request is done.
     void WriteSector(int sectorNumber, char *data);
 
+    void ReadSectors(int firstSector, int numSectors, char *data);
+    void WriteSectors(int firstSector, int numSectors, char *data);
+    // Read/write "numSectors" consecutive
+    // sectors, "data" holding all of them
+
+    void Flush(); // Write every dirty cached sector
+                  // back to the disk
+
+    void BeginBulkWrite(); // Collect writes in host memory,
+    void EndBulkWrite();   // and write them out in one go; only
+                           // while no other thread uses the disk
+
+    void Prefetch(int sectorNumber); // Start reading a sector into the
+                                     // cache, without waiting for it
+    int ReadAheadWindow() { return readAheadWindow; }
+    // How many sectors to prefetch past
+    // a sequential read
+
+    static void ReadAheadWorker(void *data); // Body of the read ahead
+                                             // thread
+
     void CallBack(); // Called by the disk device interrupt
                      // handler, to signal that the
                      // current disk operation is complete.
 
 private:
-    Disk *disk;           // Raw disk device
-    Semaphore *semaphore; // To synchronize requesting thread
-                          // with the interrupt handler
-    Lock *lock;           // Only one read/write request
-                          // can be sent to the disk at a time
+    Disk *disk;             // Raw disk device
+    Lock *lock;             // Protects the cache; not held
+                            // while waiting for the disk
+    Condition *entryReady;  // Signalled when a busy cache
+                            // entry is no longer busy
+
+    DiskRequest *current;   // Request the disk is serving, or NULL
+    DiskRequest *pending;   // Requests waiting for the disk,
+                            // sorted by sector
+    int numPending;         // Length of the pending list
+    int headSector;         // Sector of the last request started
+
+    CacheEntry *cache;                        // The buffer cache
+    HashTable<int, CacheEntry *> *cacheTable; // Cached sector -> entry
+    CacheEntry *mostRecent;                   // Head of the LRU list
+    CacheEntry *leastRecent;                  // Tail of the LRU list
+
+    int readAheadWindow;                 // Sectors to read ahead, 0 if off
+    List<int> *prefetchQueue;            // Sectors waiting to be prefetched
+    Condition *prefetchReady;            // Signalled when one is queued
+
+    char *bulkImage;        // Sectors written since BeginBulkWrite,
+                            // indexed by sector; NULL if not bulk
+    bool *bulkWritten;      // Which of them were written
+    int bulkSectors;        // Number of sectors bulkImage can hold
+
+    CacheEntry *FindEntry(int sectorNumber);  // Cache lookup, NULL on miss;
+                                              // waits while it is busy
+    CacheEntry *ClaimEntry(int sectorNumber); // Evict the LRU entry and
+                                              // reuse it for sectorNumber
+    void MoveToFront(CacheEntry *entry);      // Mark entry most recently used
+    bool BulkRead(int firstSector, int numSectors, char *data);
+                                              // Copy out the sectors in
+                                              // bulkImage; TRUE if all were
+    void BulkWrite(int firstSector, int numSectors, char *data);
+    void FillEntries(CacheEntry **entries, int count); // Read consecutive
+                                              // sectors into their entries
+    void WriteBackEntries(CacheEntry **entries, int count); // Write them
+    int DirtyRun(CacheEntry *entry, CacheEntry **run); // Dirty neighbours
+                                              // to write back with entry
+
+    void DiskRead(int sectorNumber, int count, char *data);  // Uncached disk
+    void DiskWrite(int sectorNumber, int count, char *data); // I/O; caller
+                                              // holds the lock, which is
+                                              // released during the transfer
+    void Submit(DiskRequest *request);       // Queue a request, and wait
+                                             // for the disk to finish it
+    void StartRequest(DiskRequest *request); // Hand a request to the disk
+    DiskRequest *NextRequest();              // Take the next pending
+                                             // request, C-LOOK order
 };
 
 #endif // SYNCHDISK_H
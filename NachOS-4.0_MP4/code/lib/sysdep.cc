@@ -32,6 +32,9 @@
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <cerrno>
 
 #ifdef SOLARIS
@@ -379,6 +382,27 @@ Lseek(int fd, int offset, int whence)
     ASSERT(retVal >= 0);
 }
 
+//----------------------------------------------------------------------
+// ReadAtOffset/WriteAtOffset
+// 	Read/write characters at a given location within an open file,
+//	without moving the file's current location.  One host call
+//	in place of Lseek followed by Read/WriteFile.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+ReadAtOffset(int fd, char *buffer, int nBytes, int offset)
+{
+    int retVal = pread(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
+void
+WriteAtOffset(int fd, char *buffer, int nBytes, int offset)
+{
+    int retVal = pwrite(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
 //----------------------------------------------------------------------
 // Tell
 // 	Report the current location within an open file.
@@ -420,6 +444,108 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// ListDirectory
+// 	Read the names in a directory, in alphabetical order, leaving
+//	out "." and "..".  Return the number of names, or -1 if the
+//	directory can't be read.
+//
+//	"names" -- set to an array of the names, to be freed with
+//		FreeDirectoryList
+//----------------------------------------------------------------------
+
+static int
+NotDotOrDotDot(const struct dirent *entry)
+{
+    return strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0;
+}
+
+int
+ListDirectory(char *name, char ***names)
+{
+    struct dirent **entries;
+    int count = scandir(name, &entries, NotDotOrDotDot, alphasort);
+
+    if (count < 0)
+        return -1;
+    *names = new char *[count];
+    for (int i = 0; i < count; i++) {
+        (*names)[i] = new char[strlen(entries[i]->d_name) + 1];
+        strcpy((*names)[i], entries[i]->d_name);
+        free(entries[i]);
+    }
+    free(entries);
+    return count;
+}
+
+//----------------------------------------------------------------------
+// FreeDirectoryList
+// 	Free a list of names made by ListDirectory.
+//----------------------------------------------------------------------
+
+void
+FreeDirectoryList(char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+        delete [] names[i];
+    delete [] names;
+}
+
+//----------------------------------------------------------------------
+// IsDirectory
+// 	Is "name" a directory?
+//----------------------------------------------------------------------
+
+bool
+IsDirectory(char *name)
+{
+    struct stat info;
+
+    return stat(name, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "nBytes" of an open file into our address space,
+//	shared, so that stores into the mapping change the file.
+//	Return NULL if the file can't be mapped.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int nBytes)
+{
+    void *addr = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+
+    if (addr == MAP_FAILED)
+        return NULL;
+    return (char *)addr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Force the changes made through a mapping out to the file.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int nBytes)
+{
+    int retVal = msync(addr, nBytes, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int nBytes)
+{
+    int retVal = munmap(addr, nBytes);
+    ASSERT(retVal == 0);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -49,10 +49,25 @@ extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
+extern void ReadAtOffset(int fd, char *buffer, int nBytes, int offset);
+extern void WriteAtOffset(int fd, char *buffer, int nBytes, int offset);
 extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
 
+// List the names in a directory (other than "." and ".."), sorted;
+// returns how many, or -1 if "name" is not a directory.  The list is
+// freed with FreeDirectoryList.
+extern int ListDirectory(char *name, char ***names);
+extern void FreeDirectoryList(char **names, int count);
+extern bool IsDirectory(char *name);
+
+// Map an open file into memory, so it can be read and written as an
+// array; MapFile returns NULL if the host can't map it.
+extern char *MapFile(int fd, int nBytes);
+extern void SyncMappedFile(char *addr, int nBytes);
+extern void UnmapFile(char *addr, int nBytes);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
@@ -31,7 +31,8 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  Then map the file into
+//	memory, unless the kernel asked for pread/pwrite.
 //
 //	"toCall" -- object to call when disk read/write request completes
 //----------------------------------------------------------------------
@@ -58,22 +59,45 @@ Disk::Disk(CallBackObj *toCall)
         fileno = OpenForWrite(diskname);
         magicNum = MagicNumber;
         WriteFile(fileno, (char *)&magicNum, MagicSize); // write magic number
+    }
 
-        // need to write at end of file, so that reads will not return EOF
+    // need to write at end of file, so that reads will not return EOF
+    // (nor touch an unbacked page of the mapping); a file left by a
+    // smaller disk is extended the same way
+    Lseek(fileno, 0, 2);
+    if (Tell(fileno) < DiskSize)
+    {
         Lseek(fileno, DiskSize - sizeof(int), 0);
         WriteFile(fileno, (char *)&tmp, sizeof(int));
     }
+    image = NULL;
+    if (kernel->diskMapped)
+    {
+        image = MapFile(fileno, DiskSize);
+        if (image == NULL)
+        {
+            DEBUG(dbgDisk, "Can't map " << diskname << ", using pread/pwrite.");
+        }
+    }
     active = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk.  A mapped file is first forced out to the host's disk, if
+//	the kernel asked for that (the default); otherwise the host
+//	writes the pages back whenever it likes.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (image != NULL)
+    {
+        if (kernel->diskSyncOnHalt)
+            SyncMappedFile(image, DiskSize);
+        UnmapFile(image, DiskSize);
+    }
     Close(fileno);
 }
 
@@ -115,38 +139,72 @@ PrintSector(bool writing, int sector, char *data)
 
 void Disk::ReadRequest(int sectorNumber, char *data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadSectors(sectorNumber, 1, data);
+}
+
+void Disk::WriteRequest(int sectorNumber, char *data)
+{
+    WriteSectors(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadSectors/WriteSectors
+// 	Simulate a request to read/write a range of consecutive disk
+//	sectors, as a single transfer: one seek, one host read or write,
+//	and one interrupt when the last sector has gone past the head.
+//
+//	"firstSector" -- the first disk sector to read/write
+//	"numSectors" -- how many sectors to transfer
+//	"data" -- the bytes to be written, the buffer to hold the incoming
+//		bytes; numSectors * SectorSize bytes long
+//----------------------------------------------------------------------
+
+void Disk::ReadSectors(int firstSector, int numSectors, char *data)
+{
+    int ticks = ComputeLatency(firstSector, numSectors, FALSE);
 
     ASSERT(!active); // only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT(numSectors > 0);
+    ASSERT((firstSector >= 0) && (firstSector + numSectors <= NumSectors));
 
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Reading " << numSectors << " sectors from sector " << firstSector);
+    if (image != NULL)
+        bcopy(image + SectorSize * firstSector + MagicSize, data,
+              SectorSize * numSectors);
+    else
+        ReadAtOffset(fileno, data, SectorSize * numSectors,
+                     SectorSize * firstSector + MagicSize);
     if (debug->IsEnabled('d'))
-        PrintSector(FALSE, sectorNumber, data);
+        for (int i = 0; i < numSectors; i++)
+            PrintSector(FALSE, firstSector + i, data + i * SectorSize);
 
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(firstSector + numSectors - 1);
     kernel->stats->numDiskReads++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
-void Disk::WriteRequest(int sectorNumber, char *data)
+void Disk::WriteSectors(int firstSector, int numSectors, char *data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(firstSector, numSectors, TRUE);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT(numSectors > 0);
+    ASSERT((firstSector >= 0) && (firstSector + numSectors <= NumSectors));
 
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Writing " << numSectors << " sectors to sector " << firstSector);
+    if (image != NULL)
+        bcopy(data, image + SectorSize * firstSector + MagicSize,
+              SectorSize * numSectors);
+    else
+        WriteAtOffset(fileno, data, SectorSize * numSectors,
+                      SectorSize * firstSector + MagicSize);
     if (debug->IsEnabled('d'))
-        PrintSector(TRUE, sectorNumber, data);
+        for (int i = 0; i < numSectors; i++)
+            PrintSector(TRUE, firstSector + i, data + i * SectorSize);
 
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(firstSector + numSectors - 1);
     kernel->stats->numDiskWrites++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
@@ -245,6 +303,22 @@ int Disk::ComputeLatency(int newSector, bool writing)
     return (seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::ComputeLatency(int, int, bool)
+// 	Return how long a request for "numSectors" consecutive sectors
+//	will take: the latency of the first one, then one RotationTime
+//	per further sector as they pass under the head, plus a one track
+//	seek whenever the range crosses onto the next track.
+//----------------------------------------------------------------------
+
+int Disk::ComputeLatency(int firstSector, int numSectors, bool writing)
+{
+    int endSector = firstSector + numSectors - 1;
+    int tracks = endSector / SectorsPerTrack - firstSector / SectorsPerTrack;
+
+    return ComputeLatency(firstSector, writing) + (numSectors - 1) * RotationTime + tracks * SeekTime;
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
@@ -258,6 +332,7 @@ void Disk::UpdateLast(int newSector)
 
     if (seek != 0)
         bufferInit = kernel->stats->totalTicks + seek + rotate;
+    kernel->stats->numSeekTracks += seek / SeekTime;
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
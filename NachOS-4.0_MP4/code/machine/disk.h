@@ -34,6 +34,9 @@
 // and an interrupt is invoked later to signal that the operation completed.
 //
 // The physical disk is in fact simulated via operations on a UNIX file.
+// By default the file is mapped into memory, so that a transfer is a
+// memory copy rather than a system call; failing that, or with
+// "-dio pread", each transfer is one pread/pwrite on the file.
 //
 // To make life a little more realistic, the simulated time for
 // each operation reflects a "track buffer" -- RAM to store the contents
@@ -69,6 +72,12 @@ class Disk : public CallBackObj {
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadSectors(int firstSector, int numSectors, char* data);
+    void WriteSectors(int firstSector, int numSectors, char* data);
+    					// Read/write "numSectors" consecutive
+					// sectors as a single request, with
+					// one interrupt when all are done.
+
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
@@ -76,10 +85,14 @@ class Disk : public CallBackObj {
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
+    int ComputeLatency(int firstSector, int numSectors, bool writing);
+    					// Same, for a multi-sector request
 
   private:
     int fileno;				// UNIX file number for simulated disk 
     char diskname[32];			// name of simulated disk's file
+    char *image;			// the file mapped into memory, or
+					// NULL if we use pread/pwrite
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
     bool active;     			// Is a disk operation in progress?
     int lastSector;			// The previous disk request 
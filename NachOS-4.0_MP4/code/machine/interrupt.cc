@@ -23,6 +23,7 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "synchdisk.h"
 
 // String definitions for debugging messages
 
@@ -188,6 +189,24 @@ void Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::NextDue
+// 	Return the time at which OneTick next has more to do than advance
+//	the clock: when the earliest pending interrupt is due, or now if
+//	a handler has already asked for a context switch; or -1 if there
+//	is nothing to do.  Until then the machine simulation can run user
+//	instructions in a batch, and call OneTick for the last one only.
+//----------------------------------------------------------------------
+
+int Interrupt::NextDue()
+{
+    if (yieldOnReturn)
+        return kernel->stats->totalTicks;
+    if (pending->IsEmpty())
+        return -1;
+    return pending->Front()->when;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -253,7 +272,16 @@ void Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
-    delete debug;
+    // mp4
+    // write the disk buffer cache back while the devices
+    // are still alive, along with the data of files that
+    // were written past their end and never closed; the
+    // kernel deletes the debug flags once everything has
+    // been shut down
+#ifndef FILESYS_STUB
+    kernel->inodeTable->Flush();
+#endif
+    kernel->synchDisk->Flush();
 
     delete kernel; // Never returns.
 }
@@ -121,6 +121,9 @@ class Interrupt {
     
     void OneTick();       	// Advance simulated time
 
+    int NextDue();		// mp4: time the next pending interrupt
+				// is due, or -1 if there is none
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     SortedList<PendingInterrupt *> *pending;		
@@ -61,6 +61,16 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
         mainMemory[i] = 0;
+    decodeCache = new Instruction[MemorySize / 4];
+    blockLength = new char[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+    {
+        decodeCache[i].opCode = 0;
+        blockLength[i] = 0;
+    }
+    codePage = new bool[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+        codePage[i] = FALSE;
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -73,6 +83,10 @@ Machine::Machine(bool debug)
 
     singleStep = debug;
     CheckEndian();
+
+    blockPC = -1;
+    cacheTranslations = !::debug->IsEnabled(dbgAddr);
+    FlushTranslations();
 }
 
 //----------------------------------------------------------------------
@@ -83,6 +97,9 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete[] mainMemory;
+    delete[] decodeCache;
+    delete[] blockLength;
+    delete[] codePage;
     if (tlb != NULL)
         delete[] tlb;
 }
@@ -100,6 +117,14 @@ Machine::~Machine()
 void Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
+    if (blockPC != -1)
+    { // mp4: charge the instructions of the block done before this one
+        int done = (registers[PCReg] - blockPC) / 4;
+
+        kernel->stats->totalTicks += done * UserTick;
+        kernel->stats->userTicks += done * UserTick;
+        blockPC = -1;
+    }
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0); // finish anything in progress
     kernel->interrupt->setStatus(SystemMode);
@@ -77,6 +77,43 @@ enum ExceptionType
 
 #define NumTotalRegs 40
 
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+//
+// mp4: the machine keeps the decoded form of every instruction it has
+// run, so it is defined here rather than in mipssim.cc.
+
+class Instruction
+{
+public:
+	void Decode(); // decode the binary representation of the instruction
+
+	unsigned int value; // binary representation of the instruction
+
+	char opCode;	 // Type of instruction.  This is NOT the same as the
+					 // opcode field from the instruction: see defs in mips.h
+					 // 0 if not decoded yet (see Machine::decodeCache)
+	char rs, rt, rd; // Three registers from instruction.
+	int extra;		 // Immediate or target or shamt field or offset.
+					 // Immediates are sign-extended.
+};
+
+// mp4: a virtual page that Machine::Translate has already checked, and
+// where its frame is in mainMemory (see FlushTranslations).
+
+#define TranslationCacheSize 32 // entries, each for reads and for writes
+
+class CachedTranslation
+{
+public:
+	int virtualPage; // -1 if the entry is empty
+	char *page;		 // &mainMemory[its frame * PageSize]
+};
+
 // The following class defines the simulated host workstation hardware, as
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our
@@ -90,7 +127,6 @@ enum ExceptionType
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
 class Interrupt;
 
 class Machine
@@ -146,14 +182,33 @@ public:
 	// Read or write 1, 2, or 4 bytes of virtual
 	// memory (at addr).  Return FALSE if a
 	// correct translation couldn't be found.
+
+	void InvalidateCode(int physAddr, int size);
+	// mp4: forget the decoded instructions of
+	// "size" bytes of main memory at physAddr,
+	// after the kernel wrote to them directly
+
+	void FlushTranslations();
+	// mp4: forget the translations cached by
+	// Translate, after the kernel changed the
+	// page table or switched to another one
 private:
 	// Routines internal to the machine simulation -- DO NOT call these directly
 	void DelayedLoad(int nextReg, int nextVal);
 	// Do a pending delayed load (modifying a reg)
 
-	void OneInstruction(Instruction *instr);
+	void OneInstruction();
 	// Run one instruction of a user program.
 
+	bool RunBlock(); // mp4: run the basic block at the PC;
+		// FALSE if OneTick is due after it
+	void FindBlock(int physAddr); // record the length of the
+		// block starting at physAddr
+	Instruction *FetchInstruction(int physAddr);
+	// The decoded instruction at physAddr
+	bool ExecuteInstruction(Instruction *instr);
+	// Execute it; FALSE if it raised an exception
+
 	ExceptionType Translate(int virtAddr, int *physAddr, int size, bool writing);
 	// Translate an address, and check for
 	// alignment.  Set the use and dirty bits in
@@ -172,6 +227,25 @@ private:
 
 	int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+	// mp4: decoded instructions, one for each word of main memory, so an
+	// instruction that runs again is neither fetched nor decoded again.
+	// A page's entries are dropped when it is written to.
+	Instruction *decodeCache;
+	char *blockLength; // length of the basic block starting at each
+		// word, 0 if not known (see RunBlock)
+	bool *codePage; // whether a physical page has decoded entries
+	int blockPC; // PC at the start of the block RunBlock is running,
+		// -1 if none; RaiseException charges the ticks of
+		// its instructions so far
+
+	// mp4: translations of recently used pages, found by the low bits
+	// of the virtual page number; separate ones for writes, since a
+	// page may be read-only, or hold code that a write must invalidate.
+	// Not used with a TLB, or when tracing address translation.
+	CachedTranslation readCache[TranslationCacheSize];
+	CachedTranslation writeCache[TranslationCacheSize];
+	bool cacheTranslations; // whether Translate fills them
+
 	bool singleStep; // drop back into the debugger after each
 		// simulated instruction
 	int runUntilTime; // drop back into the debugger when simulated
@@ -23,27 +23,6 @@
 
 static void Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-class Instruction
-{
-public:
-	void Decode(); // decode the binary representation of the instruction
-
-	unsigned int value; // binary representation of the instruction
-
-	char opCode;	 // Type of instruction.  This is NOT the same as the
-					 // opcode field from the instruction: see defs in mips.h
-	char rs, rt, rd; // Three registers from instruction.
-	int extra;		 // Immediate or target or shamt field or offset.
-					 // Immediates are sign-extended.
-};
-
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -55,8 +34,6 @@ public:
 
 void Machine::Run()
 {
-	Instruction *instr = new Instruction; // storage for decoded instruction
-
 	if (debug->IsEnabled('m'))
 	{
 		cout << "Starting program in thread: " << kernel->currentThread->getName();
@@ -65,13 +42,170 @@ void Machine::Run()
 	kernel->interrupt->setStatus(UserMode);
 	for (;;)
 	{
-		OneInstruction(instr);
-		kernel->interrupt->OneTick();
+		// mp4: a block at a time, unless each instruction has to be
+		// seen by the debugger or the interrupt trace
+		if (singleStep || debug->IsEnabled(dbgInt))
+		{
+			OneInstruction();
+			kernel->interrupt->OneTick();
+		}
+		else
+		{
+			while (RunBlock())
+				; // nothing due yet
+			kernel->interrupt->OneTick();
+		}
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 			Debugger();
 	}
 }
 
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Execute the basic block starting at the PC: the straight-line run
+//	of instructions up to the first branch or jump and its delay slot,
+//	staying within one page.  The block is found once, and its length
+//	kept with the decoded instructions; it is dropped with them when
+//	its page is written.
+//
+//	Only the first instruction's address is translated, since the rest
+//	are on the same page.  OneTick only has work to do once the next
+//	interrupt is due, so until then the ticks of whole blocks are
+//	charged in one go, and OneTick is called for the instruction that
+//	reaches that time.  The block is cut short there, and it ends at
+//	any exception, where RaiseException first charges the instructions
+//	done so far; so the kernel always sees the same state, at the same
+//	time, as when running one instruction at a time.
+//
+//	Returns TRUE if the block is done and fully charged, FALSE if the
+//	caller has to call OneTick for its last instruction.
+//----------------------------------------------------------------------
+
+bool Machine::RunBlock()
+{
+	Statistics *stats = kernel->stats;
+	int pc = registers[PCReg];
+	int physAddr, start, length, due;
+	bool deadline = FALSE;
+
+	// a block is entered at its top only, and not in a delay slot
+	if (registers[NextPCReg] != pc + 4)
+	{
+		OneInstruction();
+		return FALSE;
+	}
+	ExceptionType exception = Translate(pc, &physAddr, 4, FALSE);
+	if (exception != NoException)
+	{
+		RaiseException(exception, pc);
+		return FALSE;
+	}
+	start = physAddr / 4;
+	if (blockLength[start] == 0)
+		FindBlock(physAddr);
+	length = blockLength[start];
+	due = kernel->interrupt->NextDue();
+	if (due != -1)
+	{
+		// the instruction whose tick reaches "due", counted from 1
+		int reach = divRoundUp(due - stats->totalTicks, UserTick);
+		if (reach <= length)
+		{
+			length = max(reach, 1);
+			deadline = TRUE;
+		}
+	}
+
+	int done = 0;
+	blockPC = pc;
+	while (done < length && registers[PCReg] == pc + 4 * done &&
+		   decodeCache[start + done].opCode != 0)
+	{
+		if (!ExecuteInstruction(&decodeCache[start + done]))
+			return FALSE; // RaiseException charged the rest
+		done++;
+	}
+	blockPC = -1;
+
+	if (deadline && done == length)
+		done--; // OneTick charges the last one
+	else
+		deadline = FALSE;
+	stats->totalTicks += done * UserTick;
+	stats->userTicks += done * UserTick;
+	return !deadline;
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Decode the basic block starting at "physAddr", and record its
+//	length.  It ends with the delay slot of the first branch or jump,
+//	with a system call or an illegal instruction, or at the end of
+//	the page.
+//----------------------------------------------------------------------
+
+void Machine::FindBlock(int physAddr)
+{
+	int pageEnd = (physAddr / PageSize + 1) * PageSize;
+	int length = 0;
+	bool delaySlot = FALSE;
+
+	for (int addr = physAddr; addr < pageEnd; addr += 4)
+	{
+		Instruction *instr = FetchInstruction(addr);
+
+		length++;
+		if (delaySlot)
+			break;
+		switch (instr->opCode)
+		{
+		case OP_BEQ:
+		case OP_BGEZ:
+		case OP_BGEZAL:
+		case OP_BGTZ:
+		case OP_BLEZ:
+		case OP_BLTZ:
+		case OP_BLTZAL:
+		case OP_BNE:
+		case OP_J:
+		case OP_JAL:
+		case OP_JALR:
+		case OP_JR:
+			delaySlot = TRUE;
+			break;
+		case OP_SYSCALL:
+		case OP_RES:
+		case OP_UNIMP:
+			addr = pageEnd; // always traps
+			break;
+		}
+	}
+	blockLength[physAddr / 4] = length;
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Return the decoded instruction at "physAddr", decoding it first if
+//	this is the first time it is needed.
+//----------------------------------------------------------------------
+
+Instruction *Machine::FetchInstruction(int physAddr)
+{
+	Instruction *instr = &decodeCache[physAddr / 4];
+
+	if (instr->opCode == 0)
+	{
+		instr->value = WordToHost(*(unsigned int *)&mainMemory[physAddr]);
+		instr->Decode();
+		if (!codePage[physAddr / PageSize])
+		{
+			codePage[physAddr / PageSize] = TRUE;
+			FlushTranslations(); // writes to it must now invalidate it
+		}
+	}
+	return instr;
+}
+
 //----------------------------------------------------------------------
 // TypeToReg
 // 	Retrieve the register # referred to in an instruction.
@@ -116,25 +250,42 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one thing we do keep is the decoded form of each instruction,
+//	by physical address; it is dropped whenever its memory is written.
+//----------------------------------------------------------------------
+
+void Machine::OneInstruction()
+{
+	int physAddr;
+
+	// Fetch instruction, unless it was decoded before
+	ExceptionType exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+	if (exception != NoException)
+	{
+		RaiseException(exception, registers[PCReg]);
+		return;
+	}
+	(void)ExecuteInstruction(FetchInstruction(physAddr));
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute a decoded instruction, the one at the PC.  Return FALSE
+//	if it raised an exception, in which case the kernel has already
+//	handled it.
 //----------------------------------------------------------------------
 
-void Machine::OneInstruction(Instruction *instr)
+bool Machine::ExecuteInstruction(Instruction *instr)
 {
 #ifdef SIM_FIX
 	int byte; // described in Kane for LWL,LWR,...
 #endif
 
-	int raw;
 	int nextLoadReg = 0;
 	int nextLoadValue = 0; // record delayed load operation, to apply
 		// in the future
 
-	// Fetch instruction
-	if (!ReadMem(registers[PCReg], 4, &raw))
-		return; // exception occurred
-	instr->value = raw;
-	instr->Decode();
-
 	if (debug->IsEnabled('m'))
 	{
 		struct OpString *str = &opStrings[instr->opCode];
@@ -163,7 +314,7 @@ void Machine::OneInstruction(Instruction *instr)
 			((registers[instr->rs] ^ sum) & SIGN_BIT))
 		{
 			RaiseException(OverflowException, 0);
-			return;
+			return FALSE;
 		}
 		registers[instr->rd] = sum;
 		break;
@@ -174,7 +325,7 @@ void Machine::OneInstruction(Instruction *instr)
 			((instr->extra ^ sum) & SIGN_BIT))
 		{
 			RaiseException(OverflowException, 0);
-			return;
+			return FALSE;
 		}
 		registers[instr->rt] = sum;
 		break;
@@ -275,7 +426,7 @@ void Machine::OneInstruction(Instruction *instr)
 	case OP_LBU:
 		tmp = registers[instr->rs] + instr->extra;
 		if (!ReadMem(tmp, 1, &value))
-			return;
+			return FALSE;
 
 		if ((value & 0x80) && (instr->opCode == OP_LB))
 			value |= 0xffffff00;
@@ -291,10 +442,10 @@ void Machine::OneInstruction(Instruction *instr)
 		if (tmp & 0x1)
 		{
 			RaiseException(AddressErrorException, tmp);
-			return;
+			return FALSE;
 		}
 		if (!ReadMem(tmp, 2, &value))
-			return;
+			return FALSE;
 
 		if ((value & 0x8000) && (instr->opCode == OP_LH))
 			value |= 0xffff0000;
@@ -314,10 +465,10 @@ void Machine::OneInstruction(Instruction *instr)
 		if (tmp & 0x3)
 		{
 			RaiseException(AddressErrorException, tmp);
-			return;
+			return FALSE;
 		}
 		if (!ReadMem(tmp, 4, &value))
-			return;
+			return FALSE;
 		nextLoadReg = instr->rt;
 		nextLoadValue = value;
 		break;
@@ -337,7 +488,7 @@ void Machine::OneInstruction(Instruction *instr)
 		// DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
 		if (!ReadMem(tmp - byte, 4, &value))
-			return;
+			return FALSE;
 #else
 		// ReadMem assumes all 4 byte requests are aligned on an even
 		// word boundary.  Also, the little endian/big endian swap code would
@@ -345,7 +496,7 @@ void Machine::OneInstruction(Instruction *instr)
 		ASSERT((tmp & 0x3) == 0);
 
 		if (!ReadMem(tmp, 4, &value))
-			return;
+			return FALSE;
 #endif
 
 		if (registers[LoadReg] == instr->rt)
@@ -389,7 +540,7 @@ void Machine::OneInstruction(Instruction *instr)
 		// DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
 		if (!ReadMem(tmp - byte, 4, &value))
-			return;
+			return FALSE;
 #else
 		// ReadMem assumes all 4 byte requests are aligned on an even
 		// word boundary.  Also, the little endian/big endian swap code would
@@ -397,7 +548,7 @@ void Machine::OneInstruction(Instruction *instr)
 		ASSERT((tmp & 0x3) == 0);
 
 		if (!ReadMem(tmp, 4, &value))
-			return;
+			return FALSE;
 #endif
 
 		if (registers[LoadReg] == instr->rt)
@@ -469,12 +620,12 @@ void Machine::OneInstruction(Instruction *instr)
 
 	case OP_SB:
 		if (!WriteMem((unsigned)(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-			return;
+			return FALSE;
 		break;
 
 	case OP_SH:
 		if (!WriteMem((unsigned)(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-			return;
+			return FALSE;
 		break;
 
 	case OP_SLL:
@@ -544,7 +695,7 @@ void Machine::OneInstruction(Instruction *instr)
 			((registers[instr->rs] ^ diff) & SIGN_BIT))
 		{
 			RaiseException(OverflowException, 0);
-			return;
+			return FALSE;
 		}
 		registers[instr->rd] = diff;
 		break;
@@ -555,7 +706,7 @@ void Machine::OneInstruction(Instruction *instr)
 
 	case OP_SW:
 		if (!WriteMem((unsigned)(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-			return;
+			return FALSE;
 		break;
 
 	case OP_SWL:
@@ -571,7 +722,7 @@ void Machine::OneInstruction(Instruction *instr)
 		byte = tmp & 0x3;
 		// DEBUG('P', "Addr 0x%X\n",tmp-byte);
 		if (!ReadMem(tmp - byte, 4, &value))
-			return;
+			return FALSE;
 
 			// DEBUG('P', "Value 0x%X\n",value);
 #else
@@ -581,7 +732,7 @@ void Machine::OneInstruction(Instruction *instr)
 		ASSERT((tmp & 0x3) == 0);
 
 		if (!ReadMem((tmp & ~0x3), 4, &value))
-			return;
+			return FALSE;
 #endif
 
 #ifdef SIM_FIX
@@ -608,12 +759,12 @@ void Machine::OneInstruction(Instruction *instr)
 		}
 #ifndef SIM_FIX
 		if (!WriteMem((tmp & ~0x3), 4, value))
-			return;
+			return FALSE;
 #else
 		// DEBUG('P', "Value 0x%X\n",value);
 
 		if (!WriteMem((tmp - byte), 4, value))
-			return;
+			return FALSE;
 #endif // SIM_FIX
 		break;
 
@@ -626,7 +777,7 @@ void Machine::OneInstruction(Instruction *instr)
 		ASSERT((tmp & 0x3) == 0);
 
 		if (!ReadMem((tmp & ~0x3), 4, &value))
-			return;
+			return FALSE;
 #else
 		// The only difference between this code and the BIG ENDIAN code
 		// is that the ReadMem call is guaranteed an aligned access as
@@ -639,7 +790,7 @@ void Machine::OneInstruction(Instruction *instr)
 		// DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
 		if (!ReadMem(tmp - byte, 4, &value))
-			return;
+			return FALSE;
 			// DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
 
@@ -665,19 +816,19 @@ void Machine::OneInstruction(Instruction *instr)
 
 #ifndef SIM_FIX
 		if (!WriteMem((tmp & ~0x3), 4, value))
-			return;
+			return FALSE;
 #else
 		// DEBUG('P', "Value 0x%X\n",value);
 
 		if (!WriteMem((tmp - byte), 4, value))
-			return;
+			return FALSE;
 #endif // SIM_FIX
 
 		break;
 
 	case OP_SYSCALL:
 		RaiseException(SyscallException, 0);
-		return;
+		return FALSE;
 
 	case OP_XOR:
 		registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -690,7 +841,7 @@ void Machine::OneInstruction(Instruction *instr)
 	case OP_RES:
 	case OP_UNIMP:
 		RaiseException(IllegalInstrException, 0);
-		return;
+		return FALSE;
 
 	default:
 		ASSERT(FALSE);
@@ -706,6 +857,7 @@ void Machine::OneInstruction(Instruction *instr)
 											 // are jumping into lala-land
 	registers[PCReg] = registers[NextPCReg];
 	registers[NextPCReg] = pcAfter;
+	return TRUE;
 }
 
 //----------------------------------------------------------------------
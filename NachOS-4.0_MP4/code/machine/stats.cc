@@ -22,6 +22,9 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCacheHits = numCacheMisses = 0;
+    numPrefetches = numPrefetchHits = 0;
+    numSeekTracks = numQueuedRequests = totalQueueDepth = 0;
 }
 
 //----------------------------------------------------------------------
@@ -37,6 +40,16 @@ Statistics::Print()
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    cout << "Disk cache: hits " << numCacheHits;
+		cout << ", misses " << numCacheMisses << "\n";
+    cout << "Read ahead: sectors " << numPrefetches;
+		cout << ", hits " << numPrefetchHits << "\n";
+    if (numDiskReads + numDiskWrites > 0 && numQueuedRequests > 0) {
+	cout << "Disk queue: average seek ";
+		cout << (double)numSeekTracks / (numDiskReads + numDiskWrites);
+		cout << " tracks, average depth ";
+		cout << (double)totalQueueDepth / numQueuedRequests << "\n";
+    }
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
@@ -35,6 +35,15 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numCacheHits;		// number of disk sector requests served
+				// by the buffer cache
+    int numCacheMisses;		// number that had to go to the disk
+    int numPrefetches;		// number of sectors read ahead
+    int numPrefetchHits;	// number of those read before eviction
+    int numSeekTracks;		// tracks crossed by the disk head
+    int numQueuedRequests;	// disk requests handed to the scheduler
+    int totalQueueDepth;	// sum of the requests already outstanding
+				// when each of those arrived
 
     Statistics(); 		// initialize everything to zero
 
@@ -88,29 +88,39 @@ bool Machine::ReadMem(int addr, int size, int *value)
 	int data;
 	ExceptionType exception;
 	int physicalAddress;
+	unsigned int vpn = (unsigned)addr / PageSize;
+	CachedTranslation *cached = &readCache[vpn % TranslationCacheSize];
+	char *host;
 
-	DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
-
-	exception = Translate(addr, &physicalAddress, size, FALSE);
-	if (exception != NoException)
+	// mp4: the common case, an aligned read from a page read before
+	if (cached->virtualPage == (int)vpn && (addr & (size - 1)) == 0)
+		host = cached->page + (unsigned)addr % PageSize;
+	else
 	{
-		RaiseException(exception, addr);
-		return FALSE;
+		DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
+
+		exception = Translate(addr, &physicalAddress, size, FALSE);
+		if (exception != NoException)
+		{
+			RaiseException(exception, addr);
+			return FALSE;
+		}
+		host = &mainMemory[physicalAddress];
 	}
 	switch (size)
 	{
 	case 1:
-		data = mainMemory[physicalAddress];
+		data = *host;
 		*value = data;
 		break;
 
 	case 2:
-		data = *(unsigned short *)&mainMemory[physicalAddress];
+		data = *(unsigned short *)host;
 		*value = ShortToHost(data);
 		break;
 
 	case 4:
-		data = *(unsigned int *)&mainMemory[physicalAddress];
+		data = *(unsigned int *)host;
 		*value = WordToHost(data);
 		break;
 
@@ -118,7 +128,10 @@ bool Machine::ReadMem(int addr, int size, int *value)
 		ASSERT(FALSE);
 	}
 
-	DEBUG(dbgAddr, "\tvalue read = " << *value);
+	if (!cacheTranslations)
+	{
+		DEBUG(dbgAddr, "\tvalue read = " << *value);
+	}
 	return (TRUE);
 }
 
@@ -139,27 +152,40 @@ bool Machine::WriteMem(int addr, int size, int value)
 {
 	ExceptionType exception;
 	int physicalAddress;
+	unsigned int vpn = (unsigned)addr / PageSize;
+	CachedTranslation *cached = &writeCache[vpn % TranslationCacheSize];
+	char *host;
 
-	DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
-
-	exception = Translate(addr, &physicalAddress, size, TRUE);
-	if (exception != NoException)
+	// mp4: the common case, an aligned write to a page written before,
+	// which holds no code
+	if (cached->virtualPage == (int)vpn && (addr & (size - 1)) == 0)
+		host = cached->page + (unsigned)addr % PageSize;
+	else
 	{
-		RaiseException(exception, addr);
-		return FALSE;
+		DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
+
+		exception = Translate(addr, &physicalAddress, size, TRUE);
+		if (exception != NoException)
+		{
+			RaiseException(exception, addr);
+			return FALSE;
+		}
+		host = &mainMemory[physicalAddress];
+		if (codePage[physicalAddress / PageSize])
+			InvalidateCode(physicalAddress, size);
 	}
 	switch (size)
 	{
 	case 1:
-		mainMemory[physicalAddress] = (unsigned char)(value & 0xff);
+		*host = (unsigned char)(value & 0xff);
 		break;
 
 	case 2:
-		*(unsigned short *)&mainMemory[physicalAddress] = ShortToMachine((unsigned short)(value & 0xffff));
+		*(unsigned short *)host = ShortToMachine((unsigned short)(value & 0xffff));
 		break;
 
 	case 4:
-		*(unsigned int *)&mainMemory[physicalAddress] = WordToMachine((unsigned int)value);
+		*(unsigned int *)host = WordToMachine((unsigned int)value);
 		break;
 
 	default:
@@ -169,6 +195,51 @@ bool Machine::WriteMem(int addr, int size, int value)
 	return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateCode
+//      Forget the decoded instructions and basic blocks of every page
+//	that overlaps "size" bytes of main memory at "physAddr", since
+//	they may have changed.  WriteMem does this for user stores; the
+//	kernel must call it when it writes to main memory directly.
+//
+//	"physAddr" -- the physical address of the first byte written
+//	"size" -- the number of bytes written
+//----------------------------------------------------------------------
+
+void Machine::InvalidateCode(int physAddr, int size)
+{
+	int firstPage = physAddr / PageSize;
+	int lastPage = (physAddr + size - 1) / PageSize;
+
+	for (int page = firstPage; page <= lastPage && page < NumPhysPages; page++)
+	{
+		if (!codePage[page])
+			continue;
+		for (int i = 0; i < PageSize / 4; i++)
+		{
+			decodeCache[page * PageSize / 4 + i].opCode = 0;
+			blockLength[page * PageSize / 4 + i] = 0;
+		}
+		codePage[page] = FALSE;
+	}
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+//      Empty the caches of translations kept by Translate.  The kernel
+//	must call this whenever it changes the page table, or switches to
+//	another one, so that no stale translation is used.
+//----------------------------------------------------------------------
+
+void Machine::FlushTranslations()
+{
+	for (int i = 0; i < TranslationCacheSize; i++)
+	{
+		readCache[i].virtualPage = -1;
+		writeCache[i].virtualPage = -1;
+	}
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using
@@ -178,6 +249,13 @@ bool Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	mp4: with a page table, a page that passed all these checks is
+//	remembered in readCache or writeCache, so the next access to it
+//	needs none of them.  Its use and dirty bits are already set, and
+//	stay set until the kernel changes the page table, and flushes the
+//	caches.  A page holding code is not remembered for writes, since
+//	WriteMem must invalidate the code.
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
@@ -191,6 +269,16 @@ Machine::Translate(int virtAddr, int *physAddr, int size, bool writing)
 	unsigned int vpn, offset;
 	TranslationEntry *entry;
 	unsigned int pageFrame;
+	CachedTranslation *cached;
+
+	// mp4: the common case, an aligned access to a page checked before
+	vpn = (unsigned)virtAddr / PageSize;
+	cached = &(writing ? writeCache : readCache)[vpn % TranslationCacheSize];
+	if (cached->virtualPage == (int)vpn && (virtAddr & (size - 1)) == 0)
+	{
+		*physAddr = cached->page - mainMemory + (unsigned)virtAddr % PageSize;
+		return NoException;
+	}
 
 	DEBUG(dbgAddr, "\tTranslate " << virtAddr << (writing ? " , write" : " , read"));
 
@@ -204,9 +292,8 @@ Machine::Translate(int virtAddr, int *physAddr, int size, bool writing)
 	ASSERT(tlb == NULL || pageTable == NULL);
 	ASSERT(tlb != NULL || pageTable != NULL);
 
-	// calculate the virtual page number, and offset within the page,
-	// from the virtual address
-	vpn = (unsigned)virtAddr / PageSize;
+	// calculate the offset within the page from the virtual address;
+	// the virtual page number is found above
 	offset = (unsigned)virtAddr % PageSize;
 
 	if (tlb == NULL)
@@ -259,6 +346,11 @@ Machine::Translate(int virtAddr, int *physAddr, int size, bool writing)
 		entry->dirty = TRUE;
 	*physAddr = pageFrame * PageSize + offset;
 	ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
+	if (cacheTranslations && tlb == NULL && !(writing && codePage[pageFrame]))
+	{
+		cached->virtualPage = vpn;
+		cached->page = &mainMemory[pageFrame * PageSize];
+	}
 	DEBUG(dbgAddr, "phys addr = " << *physAddr);
 	return NoException;
 }
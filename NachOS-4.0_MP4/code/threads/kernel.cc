@@ -15,6 +15,7 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "directory.h"
 #include "post.h"
 #include "synchconsole.h"
 
@@ -33,9 +34,12 @@ Kernel::Kernel(int argc, char **argv)
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
 #endif
+    readAheadWindow = 4;        // disk read ahead, default is 4 sectors
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
+    diskMapped = TRUE;          // DISK file is mmap'ed by default,
+    diskSyncOnHalt = TRUE;      // and msync'ed when we halt
 								
 	// MP4 mod tag
 	execfileNum = 0; // dummy operation to keep valgrind happy
@@ -64,10 +68,26 @@ Kernel::Kernel(int argc, char **argv)
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
 #endif
+		} else if (strcmp(argv[i], "-ra") == 0) {
+	    	ASSERT(i + 1 < argc);   // next argument is int
+	    	readAheadWindow = atoi(argv[i + 1]);
+	    	i++;
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
             reliability = atof(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "-dio") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is pread, mmap
+                                    // or mmap-nosync
+            if (strcmp(argv[i + 1], "pread") != 0 &&
+                strcmp(argv[i + 1], "mmap") != 0 &&
+                strcmp(argv[i + 1], "mmap-nosync") != 0) {
+                cout << "Partial usage: nachos [-dio pread|mmap|mmap-nosync]\n";
+                Exit(1);
+            }
+            diskMapped = (strcmp(argv[i + 1], "pread") != 0);
+            diskSyncOnHalt = (strcmp(argv[i + 1], "mmap") == 0);
+            i++;
         } else if (strcmp(argv[i], "-m") == 0) {
             ASSERT(i + 1 < argc);   // next argument is int
             hostName = atoi(argv[i + 1]);
@@ -80,6 +100,8 @@ Kernel::Kernel(int argc, char **argv)
 	    	cout << "Partial usage: nachos [-nf]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-ra #]\n";
+            cout << "Partial usage: nachos [-dio pread|mmap|mmap-nosync]\n";
 		}
     }
 }
@@ -109,10 +131,12 @@ Kernel::Initialize()
     machine = new Machine(debugUserProg);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    synchDisk = new SynchDisk(readAheadWindow);    //
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
+    dentryCache = new DentryCache();
+    inodeTable = new InodeTable();
     fileSystem = new FileSystem(formatFlag);
 #endif // FILESYS_STUB
 
@@ -142,10 +166,22 @@ Kernel::PrepareToEnd()
 //----------------------------------------------------------------------
 // Kernel::~Kernel
 // 	Nachos is halting.  De-allocate global data structures.
+//
+//	mp4: the file system goes first, while the disk cache, and the
+//	interrupts and threads its requests need, are still there; the
+//	disk cache is then flushed, with whatever the file system wrote
+//	on its way out.  The debug flags are consulted until the end.
 //----------------------------------------------------------------------
 
 Kernel::~Kernel()
 {
+    delete fileSystem;
+#ifndef FILESYS_STUB
+    delete dentryCache;
+    delete inodeTable;
+#endif
+    synchDisk->Flush();
+    delete synchDisk;
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -153,15 +189,14 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
-    delete synchDisk;
-    delete fileSystem;
 	
 	// Mp4 mod tag
 	/*
     delete postOfficeIn;
     delete postOfficeOut;
     */
-	
+
+    delete debug;
     Exit(0);
 }
 
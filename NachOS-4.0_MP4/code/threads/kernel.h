@@ -24,6 +24,7 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class DentryCache;
 
 
 
@@ -65,10 +66,17 @@ class Kernel {
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
     FileSystem *fileSystem;     
+#ifndef FILESYS_STUB
+    DentryCache *dentryCache;   // mp4: cached path lookups
+    InodeTable *inodeTable;     // mp4: headers of the open files
+#endif
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
+    bool diskMapped;            // map the DISK file into memory,
+                                // rather than pread/pwrite it
+    bool diskSyncOnHalt;        // msync the mapped DISK file at halt
 
   private:
 
@@ -84,6 +92,8 @@ class Kernel {
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
 #endif
+    int readAheadWindow;        // sectors to prefetch past a
+                                // sequential file read
 };
 
 
@@ -5,8 +5,10 @@
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
 //              -f -cp <unix file> <nachos file>
+//              -cpdir <unix directory> <nachos directory>
 //              -p <nachos file> -r <nachos file> -l -D
 //              -n <network reliability> -m <machine id>
+//              -ra <read ahead sectors> -dio <disk I/O mode>
 //              -z -K -C -N
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
@@ -18,6 +20,10 @@
 //    -co specify file for console output (stdout is the default)
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
+//    -ra sets how many disk sectors to read ahead of sequential file reads
+//    -dio sets how the DISK file is accessed: "mmap" (the default) maps
+//       it and msyncs it at halt, "mmap-nosync" leaves the write back to
+//       the host, "pread" uses a pread/pwrite per transfer
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
@@ -25,6 +31,7 @@
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
 //    -cp copies a file from UNIX to Nachos
+//    -cpdir copies a whole UNIX directory tree into a Nachos directory
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
@@ -74,13 +81,17 @@ static const int TransferSize = 128;
 //----------------------------------------------------------------------
 // Copy
 //      Copy the contents of the UNIX file "from" to the Nachos file "to"
+//
+//	The Nachos file is created at its final size, so its sectors are
+//	allocated in as few contiguous runs as possible, and then written
+//	with a single Write, which transfers each run as one disk request.
 //----------------------------------------------------------------------
 
 static void Copy(char *from, char *to)
 {
     int fd;
     OpenFile *openFile;
-    int amountRead, fileLength;
+    int fileLength;
     char *buffer;
 
     // Open UNIX file
@@ -107,10 +118,10 @@ static void Copy(char *from, char *to)
     openFile = kernel->fileSystem->Open(to);
     ASSERT(openFile != NULL);
 
-    // Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead = ReadPartial(fd, buffer, sizeof(char) * TransferSize)) > 0)
-        openFile->Write(buffer, amountRead);
+    // Copy the data in one piece; a Nachos file is small enough
+    buffer = new char[fileLength];
+    Read(fd, buffer, fileLength);
+    openFile->Write(buffer, fileLength);
     delete[] buffer;
 
     // Close the UNIX and the Nachos files
@@ -118,6 +129,57 @@ static void Copy(char *from, char *to)
     Close(fd);
 }
 
+//----------------------------------------------------------------------
+// CopyDirectory
+//      Copy a UNIX directory tree into the Nachos directory "to",
+//	creating "to" if need be: files are copied with Copy,
+//	subdirectories recursively.  Names too long for a Nachos
+//	directory entry are skipped.
+//
+//	Everything is done in one run of Nachos, so the file system
+//	metadata stays in the disk cache from one file to the next.
+//----------------------------------------------------------------------
+
+static void CopyDirectory(char *from, char *to)
+{
+    char **names;
+    int count;
+
+    if ((count = ListDirectory(from, &names)) < 0)
+    {
+        printf("Copy: couldn't open input directory %s\n", from);
+        return;
+    }
+    // an existing "to" must be a directory; a file there makes the
+    // create fail
+    if (!kernel->fileSystem->IsDirectory(to) &&
+        !kernel->fileSystem->CreateFile(to, DirectoryFileSize, 1))
+    {
+        printf("Copy: couldn't create output directory %s\n", to);
+        FreeDirectoryList(names, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        char *unixName = new char[strlen(from) + strlen(names[i]) + 2];
+        char *nachosName = new char[strlen(to) + strlen(names[i]) + 2];
+
+        sprintf(unixName, "%s/%s", from, names[i]);
+        sprintf(nachosName, "%s/%s", (strcmp(to, "/") == 0) ? "" : to,
+                names[i]);
+        if (strlen(names[i]) > FileNameMaxLen)
+            printf("Copy: name too long, skipping %s\n", unixName);
+        else if (IsDirectory(unixName))
+            CopyDirectory(unixName, nachosName);
+        else
+            Copy(unixName, nachosName);
+        delete[] unixName;
+        delete[] nachosName;
+    }
+    FreeDirectoryList(names, count);
+}
+
 #endif // FILESYS_STUB
 
 //----------------------------------------------------------------------
@@ -154,7 +216,7 @@ void Print(char *name)
 //----------------------------------------------------------------------
 static void CreateDirectory(char *name)
 {
-    kernel->fileSystem->CreateFile(name, NumDirEntries * sizeof(DirectoryEntry), 1);
+    kernel->fileSystem->CreateFile(name, DirectoryFileSize, 1);
 }
 
 //----------------------------------------------------------------------
@@ -182,6 +244,8 @@ int main(int argc, char **argv)
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;   // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL; // name of copied file in Nachos
+    char *copyUnixDirName = NULL;    // UNIX directory tree to be copied
+    char *copyNachosDirName = NULL;  // Nachos directory to copy it into
     char *printFileName = NULL;
     char *removeFileName = NULL;
     bool dirListFlag = false;
@@ -235,6 +299,13 @@ int main(int argc, char **argv)
             copyNachosFileName = argv[i + 2];
             i += 2;
         }
+        else if (strcmp(argv[i], "-cpdir") == 0)
+        {
+            ASSERT(i + 2 < argc);
+            copyUnixDirName = argv[i + 1];
+            copyNachosDirName = argv[i + 2];
+            i += 2;
+        }
         else if (strcmp(argv[i], "-p") == 0)
         {
             ASSERT(i + 1 < argc);
@@ -293,6 +364,7 @@ int main(int argc, char **argv)
             cout << "Partial usage: nachos [-K] [-C] [-N]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpdir UnixDir NachosDir]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
             cout << "Partial usage: nachos [-l] [-D]\n";
 #endif //FILESYS_STUB
@@ -332,6 +404,10 @@ int main(int argc, char **argv)
     {
         Copy(copyUnixFileName, copyNachosFileName);
     }
+    if (copyUnixDirName != NULL && copyNachosDirName != NULL)
+    {
+        CopyDirectory(copyUnixDirName, copyNachosDirName);
+    }
     if (dumpFlag)
     {
         kernel->fileSystem->Print();
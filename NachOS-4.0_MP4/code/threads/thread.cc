@@ -164,12 +164,20 @@ Thread::Begin ()
 //
 // 	NOTE: we disable interrupts, because Sleep() assumes interrupts
 //	are disabled.
+//
+//	mp4: the address space of a user program goes first, closing the
+//	files it left open; that may wait for the disk, so it is done
+//	before interrupts are disabled.
 //----------------------------------------------------------------------
 
 //
 void
 Thread::Finish ()
 {
+    if (space != NULL) {
+	delete space;
+	space = NULL;
+    }
     (void) kernel->interrupt->SetLevel(IntOff);		
     ASSERT(this == kernel->currentThread);
     
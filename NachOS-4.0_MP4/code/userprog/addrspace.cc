@@ -79,15 +79,27 @@ AddrSpace::AddrSpace()
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
+    kernel->machine->InvalidateCode(0, MemorySize);
+
+    // no files open yet; every id is free, lowest first
+    for (int i = 0; i < MaxOpenFiles; i++) {
+	fileTable[i] = NULL;
+	nextFreeFile[i] = (i + 1 < MaxOpenFiles) ? i + 1 : -1;
+    }
+    freeFile = 0;
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space, closing the files the program
+//	left open.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+   for (int i = 0; i < MaxOpenFiles; i++)
+	if (fileTable[i] != NULL)
+	    delete fileTable[i];
    delete pageTable;
 }
 
@@ -169,6 +181,9 @@ AddrSpace::Load(char *fileName)
     }
 #endif
 
+    // the old contents of these pages may have been run before
+    kernel->machine->InvalidateCode(0, numPages * PageSize);
+
     delete executable;			// close file
     return TRUE;			// success
 }
@@ -235,6 +250,58 @@ AddrSpace::InitRegisters()
     DEBUG(dbgAddr, "Initializing stack pointer: " << numPages * PageSize - 16);
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter an open file into the program's table, and return the
+//	OpenFileId it is known by.  Return -1 if all the ids are in use.
+//
+//	"file" -- the open file; the table owns it from now on
+//----------------------------------------------------------------------
+
+OpenFileId
+AddrSpace::AddFile(OpenFile *file)
+{
+    int id = freeFile;
+
+    if (id == -1)
+	return -1;
+    freeFile = nextFreeFile[id];
+    fileTable[id] = file;
+    return id;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFile
+// 	Return the open file known by "id", or NULL if there is none.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::GetFile(OpenFileId id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return fileTable[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Free "id" for reuse, and return the file it was known by, for
+//	the caller to close.  Return NULL if "id" was not open.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::RemoveFile(OpenFileId id)
+{
+    OpenFile *file = GetFile(id);
+
+    if (file == NULL)
+	return NULL;
+    fileTable[id] = NULL;
+    nextFreeFile[id] = freeFile;
+    freeFile = id;
+    return file;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::SaveState
 // 	On a context switch, save any machine state, specific
@@ -251,13 +318,15 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	have it forget the translations of the last one.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     kernel->machine->pageTable = pageTable;
     kernel->machine->pageTableSize = numPages;
+    kernel->machine->FlushTranslations();
 }
 
 
@@ -311,6 +380,33 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::TranslateRange
+//  Translate the virtual address in _vaddr_, the start of a buffer of
+//  _size_ bytes, to a physical address in _paddr_, and return the
+//  number of bytes of the buffer that follow it in physical memory.
+//  The following pages are translated as well, for as long as their
+//  frames are consecutive, so a system call can copy a buffer
+//  straight to or from memory in a few pieces.
+//  _mode_ is as for Translate.  Return -1 if _vaddr_ itself does not
+//  translate.
+//----------------------------------------------------------------------
 
+int
+AddrSpace::TranslateRange(unsigned int vaddr, int size, unsigned int *paddr,
+                          int mode)
+{
+    unsigned int next;
+    int length;
 
+    if (size <= 0 || Translate(vaddr, paddr, mode) != NoException)
+        return -1;
 
+    length = min(size, (int)(PageSize - vaddr % PageSize));
+    while (length < size
+           && Translate(vaddr + length, &next, mode) == NoException
+           && next == *paddr + length) {
+        length = min(size, length + PageSize);
+    }
+    return length;
+}
@@ -17,6 +17,7 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		128	// mp4: open files per address space
 
 class AddrSpace {
   public:
@@ -39,6 +40,18 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    // mp4: translate the start of the range of _size_ bytes at _vaddr_,
+    // and return how many of its bytes are contiguous in physical
+    // memory from _paddr_ on; -1 if _vaddr_ does not translate.
+    int TranslateRange(unsigned int vaddr, int size, unsigned int *paddr,
+                       int mode);
+
+    // mp4: the files opened by this program, indexed by OpenFileId
+    OpenFileId AddFile(OpenFile *file);	// Give "file" a free id; -1 if
+					// the table is full
+    OpenFile *GetFile(OpenFileId id);	// NULL if "id" is not open
+    OpenFile *RemoveFile(OpenFileId id); // Free "id", returning its file
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
@@ -48,6 +61,10 @@ class AddrSpace {
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+    OpenFile *fileTable[MaxOpenFiles];	// Open file of each id, or NULL
+    int nextFreeFile[MaxOpenFiles];	// Free ids are chained through
+    int freeFile;			// here, from freeFile; -1 if none
+
 };
 
 #endif // ADDRSPACE_H
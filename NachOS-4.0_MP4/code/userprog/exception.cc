@@ -108,10 +108,9 @@ void ExceptionHandler(ExceptionType which)
 		case SC_Write:
 			val = kernel->machine->ReadRegister(4);
 			{
-				char *buffer = &(kernel->machine->mainMemory[val]);
 				int size = kernel->machine->ReadRegister(5);
 				int id = kernel->machine->ReadRegister(6);
-				status = SysWrite(buffer, size, id);
+				status = SysWrite(val, size, id);
 				kernel->machine->WriteRegister(2,(int)status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -123,10 +122,9 @@ void ExceptionHandler(ExceptionType which)
 		case SC_Read:
 			val = kernel->machine->ReadRegister(4);
 			{
-				char *buffer = &(kernel->machine->mainMemory[val]);
 				int initialSize = kernel->machine->ReadRegister(5);
 				int id = kernel->machine->ReadRegister(6);
-				status = SysRead(buffer ,initialSize ,id);
+				status = SysRead(val ,initialSize ,id);
 				kernel->machine->WriteRegister(2,(int)status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -47,14 +47,57 @@ OpenFileId SysOpen(char *name)
   return kernel->fileSystem->FS_OpenAFile(name);
 }
 
-int SysWrite(char *buffer, int size, OpenFileId id)
-{	
-  return kernel->fileSystem->FS_WriteFile(buffer, size, id);
+// mp4
+// The user buffer at virtual address "addr" is translated piece by
+// piece, and each physically contiguous piece goes straight between
+// main memory and the file, with no copy in between.
+
+int SysWrite(int addr, int size, OpenFileId id)
+{
+  AddrSpace *space = kernel->currentThread->space;
+  unsigned int paddr;
+  int done = 0, length, result;
+
+  if (space->GetFile(id) == NULL)
+    return -1; // even for an empty transfer
+  while (done < size) {
+    length = space->TranslateRange(addr + done, size - done, &paddr, 0);
+    if (length < 0)
+      return (done > 0) ? done : -1; // a bad address
+    result = kernel->fileSystem->FS_WriteFile(
+        &kernel->machine->mainMemory[paddr], length, id);
+    if (result < 0)
+      return (done > 0) ? done : result;
+    done += result;
+    if (result < length)
+      break;
+  }
+  return done;
 }
 
-int SysRead(char *buffer, int size, OpenFileId id)
+int SysRead(int addr, int size, OpenFileId id)
 {
-  return kernel->fileSystem->FS_ReadFile(buffer, size, id);
+  AddrSpace *space = kernel->currentThread->space;
+  unsigned int paddr;
+  int done = 0, length, result;
+
+  if (space->GetFile(id) == NULL)
+    return -1; // even for an empty transfer
+  while (done < size) {
+    length = space->TranslateRange(addr + done, size - done, &paddr, 1);
+    if (length < 0)
+      return (done > 0) ? done : -1; // a bad address
+    result = kernel->fileSystem->FS_ReadFile(
+        &kernel->machine->mainMemory[paddr], length, id);
+    if (result > 0)
+      kernel->machine->InvalidateCode(paddr, result);
+    if (result < 0)
+      return (done > 0) ? done : result;
+    done += result;
+    if (result < length)
+      break; // end of file
+  }
+  return done;
 }
 
 int SysClose(OpenFileId id)